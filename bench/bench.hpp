@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <time.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <platform/type.hpp>
+
+/**
+ * @file bench.hpp
+ * @brief Helpers of the benchmarks.
+ * @details Each benchmark prints a JSON object in one line:
+ * {"bench": "poll", "results": [{"name": "...", "value": 1.0, "unit": "..."}]}
+*/
+
+namespace bench {
+
+/**
+ * @brief Get the monotonic time in nanoseconds.
+*/
+inline u64 nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<u64>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Get the percentile of the samples, the samples are sorted.
+ *
+ * @param samples is the samples
+ * @param percent is the percentile, in [0, 100]
+*/
+inline u64 percentile(std::vector<u64> *samples, double percent) {
+    if (samples->empty()) {
+        return 0;
+    }
+    std::sort(samples->begin(), samples->end());
+    size_t idx = static_cast<size_t>(samples->size() * percent / 100);
+    if (idx >= samples->size()) {
+        idx = samples->size() - 1;
+    }
+    return (*samples)[idx];
+}
+
+/**
+ * @brief The results of a benchmark, printed as JSON.
+*/
+class Report {
+ public:
+    explicit Report(const char *bench): bench(bench) {}
+
+    /**
+     * @brief Add a result.
+     *
+     * @param name is the name of the result
+     * @param value is the value of the result
+     * @param unit is the unit of the value
+    */
+    void add(const char *name, double value, const char *unit) {
+        Result result;
+        snprintf(result.name, sizeof(result.name), "%s", name);
+        result.value = value;
+        result.unit = unit;
+        results.push_back(result);
+    }
+
+    /**
+     * @brief Print the results as a JSON object in one line.
+    */
+    void print() const {
+        printf("{\"bench\": \"%s\", \"results\": [", bench);
+        for (size_t i = 0; i < results.size(); i++) {
+            printf("%s{\"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}",
+                i ? ", " : "", results[i].name, results[i].value,
+                results[i].unit);
+        }
+        printf("]}\n");
+        fflush(stdout);
+    }
+
+ private:
+    struct Result {
+        char name[64];
+        double value;
+        const char *unit;
+    };
+
+    const char *bench;
+    std::vector<Result> results;
+};
+
+}  // namespace bench
@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <common/buffer_chain.hpp>
+#include <platform/handle.hpp>
+#include <platform/handle_int.hpp>
+#include "bench.hpp"
+
+/// The total size of the frames forwarded in a round.
+#define BENCH_STREAM_SIZE (64 << 20)
+/// The number of bytes read or written at once.
+#define BENCH_IO_SIZE 65536
+/// The maximum payload size of a frame.
+#define BENCH_FRAME_MAX 2048
+/// The number of rounds of each forwarding mode.
+#define BENCH_ROUNDS 5
+
+using platform::Handle;
+using common::BufferChain;
+
+/**
+ * @brief A handle of an opened file descriptor.
+*/
+class FdHandle: public Handle {
+ public:
+    explicit FdHandle(int fd) {
+        priv->fd = fd;
+    }
+};
+
+/**
+ * @brief Write the whole buffer to a handle.
+*/
+static void writeAll(Handle *handle, void *buf, size_t len) {
+    platform::IoVec iov = {buf, len};
+    handle->writevAll(&iov, 1);
+}
+
+/**
+ * @brief Write a stream of frames, a frame is a 32-bit length and
+ * the payload.
+*/
+static void makeStream(Handle *file) {
+    std::vector<char> buf(BENCH_IO_SIZE + BENCH_FRAME_MAX + sizeof(u32));
+    size_t total = 0;
+    size_t len = 0;
+    u32 seed = 1;
+
+    while (total < BENCH_STREAM_SIZE) {
+        seed = seed * 1103515245 + 12345;
+        u32 size = 64 + (seed >> 8) % (BENCH_FRAME_MAX - 64);
+        memcpy(&buf[len], &size, sizeof(size));
+        memset(&buf[len + sizeof(size)], static_cast<int>(size), size);
+        len += sizeof(size) + size;
+        if (len >= BENCH_IO_SIZE) {
+            writeAll(file, &buf[0], len);
+            total += len;
+            len = 0;
+        }
+    }
+    if (len) {
+        writeAll(file, &buf[0], len);
+    }
+}
+
+/**
+ * @brief Forward the frames by copying each one into its own buffer,
+ * and then into the output buffer.
+ * @return the number of frames forwarded.
+*/
+static size_t forwardCopy(Handle *in, Handle *out) {
+    std::vector<char> rbuf(BENCH_IO_SIZE + BENCH_FRAME_MAX + sizeof(u32));
+    std::vector<char> wbuf(BENCH_IO_SIZE + BENCH_FRAME_MAX + sizeof(u32));
+    size_t rlen = 0;
+    size_t wlen = 0;
+    size_t frames = 0;
+
+    for (;;) {
+        size_t n;
+        try {
+            n = in->read(&rbuf[rlen], BENCH_IO_SIZE);
+        } catch (common::Exception &) {
+            break;
+        }
+        rlen += n;
+        size_t pos = 0;
+        u32 size;
+        while (rlen - pos >= sizeof(size)) {
+            memcpy(&size, &rbuf[pos], sizeof(size));
+            size_t flen = sizeof(size) + size;
+            if (rlen - pos < flen) {
+                break;
+            }
+            char *frame = static_cast<char *>(malloc(flen));
+            memcpy(frame, &rbuf[pos], flen);
+            memcpy(&wbuf[wlen], frame, flen);
+            free(frame);
+            wlen += flen;
+            pos += flen;
+            frames++;
+            if (wlen >= BENCH_IO_SIZE) {
+                writeAll(out, &wbuf[0], wlen);
+                wlen = 0;
+            }
+        }
+        memmove(&rbuf[0], &rbuf[pos], rlen - pos);
+        rlen -= pos;
+    }
+    if (wlen) {
+        writeAll(out, &wbuf[0], wlen);
+    }
+    return frames;
+}
+
+/**
+ * @brief Forward the frames by splitting them from the input chain and
+ * appending them to the output chain, the payload is never copied.
+ * @return the number of frames forwarded.
+*/
+static size_t forwardChain(Handle *in, Handle *out) {
+    BufferChain rchain;
+    BufferChain wchain;
+    BufferChain frame;
+    size_t frames = 0;
+
+    for (;;) {
+        try {
+            rchain.readFrom(in, BENCH_IO_SIZE);
+        } catch (common::Exception &) {
+            break;
+        }
+        u32 size;
+        while (rchain.getLength() >= sizeof(size)) {
+            rchain.copyOut(&size, sizeof(size));
+            size_t flen = sizeof(size) + size;
+            if (rchain.getLength() < flen) {
+                break;
+            }
+            rchain.split(flen, &frame);
+            wchain.append(frame);
+            frame.clear();
+            frames++;
+            while (wchain.getLength() >= BENCH_IO_SIZE) {
+                wchain.writeTo(out);
+            }
+        }
+    }
+    while (wchain.getLength()) {
+        wchain.writeTo(out);
+    }
+    return frames;
+}
+
+int app_main(int argc, char *argv[]) {
+    char path[] = "/tmp/buffer_bench.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return 1;
+    }
+    unlink(path);
+    FdHandle file(fd);
+    FdHandle null(open("/dev/null", O_WRONLY | O_CLOEXEC));
+    makeStream(&file);
+
+    bench::Report report("buffer");
+    struct Mode {
+        const char *rate;
+        const char *frames;
+        size_t (*forward)(Handle *in, Handle *out);
+    };
+    static const Mode modes[] = {
+        {"copy_mb_per_s", "copy_frames", forwardCopy},
+        {"chain_mb_per_s", "chain_frames", forwardChain},
+    };
+    for (size_t m = 0; m < ARRAY_LEN(modes); m++) {
+        std::vector<u64> samples;
+        size_t frames = 0;
+        for (int i = 0; i < BENCH_ROUNDS; i++) {
+            lseek(fd, 0, SEEK_SET);
+            u64 start = bench::nowNs();
+            frames = modes[m].forward(&file, &null);
+            samples.push_back(bench::nowNs() - start);
+        }
+        u64 ns = bench::percentile(&samples, 50);
+        report.add(modes[m].rate, BENCH_STREAM_SIZE * 1000.0 / ns, "MB/s");
+        report.add(modes[m].frames, static_cast<double>(frames), "frames");
+    }
+    report.print();
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <sys/socket.h>
+#include <cstdio>
+#include <platform/co.hpp>
+#include <platform/handle_int.hpp>
+#include "bench.hpp"
+
+/// The number of round trips of a benchmark.
+#define BENCH_ROUNDS 200000
+
+using platform::Handle;
+using platform::Poll;
+
+/**
+ * @brief A handle of an opened file descriptor.
+*/
+class FdHandle: public Handle {
+ public:
+    explicit FdHandle(int fd) {
+        priv->fd = fd;
+    }
+};
+
+/**
+ * @brief Create a pair of connected non-blocking sockets.
+*/
+static void createPair(FdHandle **a, FdHandle **b) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    *a = new FdHandle(fds[0]);
+    *b = new FdHandle(fds[1]);
+}
+
+/**
+ * @brief The state of a ping-pong between two ends in one poll.
+*/
+class PingPong {
+ public:
+    PingPong(): client(nullptr), server(nullptr), rounds(0), done(false) {}
+
+    FdHandle *client;
+    FdHandle *server;
+    u32 rounds;
+    bool done;      ///< the server has read the end of file
+};
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+namespace co = platform::co;
+
+/**
+ * @brief Echo until the end of file.
+*/
+static co::Task echo(Poll *poll, PingPong *pp) {
+    char buf[64];
+    for (;;) {
+        size_t len = co_await co::read(poll, pp->server, buf, sizeof(buf));
+        if (len == 0) {
+            break;
+        }
+        co_await co::write(poll, pp->server, buf, len);
+    }
+    pp->done = true;
+}
+
+/**
+ * @brief Send a byte and wait for the echo, then close the connection.
+*/
+static co::Task ping(Poll *poll, PingPong *pp) {
+    char c = 0;
+    while (pp->rounds < BENCH_ROUNDS) {
+        co_await co::write(poll, pp->client, &c, 1);
+        co_await co::read(poll, pp->client, &c, 1);
+        pp->rounds++;
+    }
+    delete pp->client;
+    pp->client = nullptr;
+}
+
+/**
+ * @brief Measure the round trips of two coroutines.
+*/
+static void benchCoroutine(bench::Report *report) {
+    PingPong pp;
+    Poll poll;
+
+    createPair(&pp.client, &pp.server);
+    u64 start = bench::nowNs();
+    echo(&poll, &pp);
+    ping(&poll, &pp);
+    while (!pp.done) {
+        poll.polling(-1);
+    }
+    u64 elapsed = bench::nowNs() - start;
+    delete pp.server;
+    report->add("coroutine_round_trips", pp.rounds * 1e9 / elapsed,
+        "trips/s");
+}
+
+#endif  // __cpp_impl_coroutine
+
+static void onServer(Poll::Event event, Handle *handle, void *arg) {
+    PingPong *pp = static_cast<PingPong *>(arg);
+    char buf[64];
+
+    platform::IoResult result = handle->tryRead(buf, sizeof(buf));
+    if (result.isEof()) {
+        pp->done = true;
+        return;
+    }
+    if (result.err == common::ERR_OK) {
+        handle->write(buf, result.len);
+    }
+}
+
+static void onClient(Poll::Event event, Handle *handle, void *arg) {
+    PingPong *pp = static_cast<PingPong *>(arg);
+    char c;
+
+    if (handle->tryRead(&c, 1).err != common::ERR_OK) {
+        return;
+    }
+    if (++pp->rounds < BENCH_ROUNDS) {
+        handle->write(&c, 1);
+    } else {
+        pp->client = nullptr;
+    }
+}
+
+/**
+ * @brief Measure the round trips of two callbacks, the baseline.
+*/
+static void benchCallback(bench::Report *report) {
+    PingPong pp;
+    Poll poll;
+    char c = 0;
+
+    createPair(&pp.client, &pp.server);
+    FdHandle *client = pp.client;
+    u64 start = bench::nowNs();
+    poll.add(pp.server, Poll::EV_READ, onServer, &pp);
+    poll.add(pp.client, Poll::EV_READ, onClient, &pp);
+    pp.client->write(&c, 1);
+    while (pp.client) {
+        poll.polling(-1);
+    }
+    poll.del(client, Poll::EV_READ);
+    delete client;
+    while (!pp.done) {
+        poll.polling(-1);
+    }
+    u64 elapsed = bench::nowNs() - start;
+    poll.del(pp.server, Poll::EV_READ);
+    delete pp.server;
+    report->add("callback_round_trips", pp.rounds * 1e9 / elapsed,
+        "trips/s");
+}
+
+int app_main(int argc, char *argv[]) {
+    bench::Report report("co");
+
+    benchCallback(&report);
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+    benchCoroutine(&report);
+#endif
+    report.print();
+    return 0;
+}
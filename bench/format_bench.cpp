@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <common/format.hpp>
+#include <platform/handle.hpp>
+#include <platform/handle_int.hpp>
+#include "bench.hpp"
+
+/// The number of iterations of a formatting benchmark.
+#define BENCH_FORMAT_ROUNDS 1000000
+/// The number of iterations of a print benchmark.
+#define BENCH_PRINT_ROUNDS 200000
+/// The size of the stack buffer of the vsnprintf() path.
+#define BENCH_FORMAT_BUF_SIZE 4096
+
+using platform::Handle;
+using common::FormatBuffer;
+
+/**
+ * @brief A handle of an opened file descriptor.
+*/
+class FdHandle: public Handle {
+ public:
+    explicit FdHandle(int fd) {
+        priv->fd = fd;
+    }
+};
+
+/**
+ * @brief The formatting before FormatBuffer, vsnprintf() into the stack.
+*/
+static size_t formatStack(char *buf, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, BENCH_FORMAT_BUF_SIZE, fmt, ap);
+    va_end(ap);
+    return n > 0 ? n : 0;
+}
+
+/**
+ * @brief Measure the formatting of a typical log line.
+*/
+static void benchFormat(bench::Report *report) {
+    char buf[BENCH_FORMAT_BUF_SIZE];
+    FormatBuffer fb;
+    size_t sum = 0;
+    char name[64];
+    struct Case {
+        const char *name;
+        const char *fmt;
+    };
+    static const Case cases[] = {
+        {"ints", "fd %d events %#x count %lu latency %5u"},
+        {"floats", "rate %.2f load %8.3f ratio %f"},
+        {"strings", "peer %s path %-16s method %.3s"},
+    };
+
+    for (size_t c = 0; c < ARRAY_LEN(cases); c++) {
+        const char *fmt = cases[c].fmt;
+        u64 start = bench::nowNs();
+        for (u32 i = 0; i < BENCH_FORMAT_ROUNDS; i++) {
+            switch (c) {
+            case 0:
+                sum += formatStack(buf, fmt, i, i, 1234567UL * i, i & 0xfff);
+                break;
+            case 1:
+                sum += formatStack(buf, fmt, i * 0.37, i / 7.0, 1.0 / (i + 1));
+                break;
+            default:
+                sum += formatStack(buf, fmt, "192.168.1.1", "/index", "GET");
+                break;
+            }
+        }
+        u64 vsn = bench::nowNs() - start;
+        start = bench::nowNs();
+        for (u32 i = 0; i < BENCH_FORMAT_ROUNDS; i++) {
+            fb.clear();
+            switch (c) {
+            case 0:
+                fb.format(fmt, i, i, 1234567UL * i, i & 0xfff);
+                break;
+            case 1:
+                fb.format(fmt, i * 0.37, i / 7.0, 1.0 / (i + 1));
+                break;
+            default:
+                fb.format(fmt, "192.168.1.1", "/index", "GET");
+                break;
+            }
+            sum += fb.getLength();
+        }
+        u64 fast = bench::nowNs() - start;
+        snprintf(name, sizeof(name), "format_%s_vsnprintf", cases[c].name);
+        report->add(name, static_cast<double>(vsn) / BENCH_FORMAT_ROUNDS,
+            "ns/op");
+        snprintf(name, sizeof(name), "format_%s_buffer", cases[c].name);
+        report->add(name, static_cast<double>(fast) / BENCH_FORMAT_ROUNDS,
+            "ns/op");
+    }
+    if (sum == 0) {
+        printf("unreachable\n");
+    }
+}
+
+/**
+ * @brief Measure Handle::print, a short line and a line longer than
+ * the old 4096-byte limit.
+*/
+static void benchPrint(bench::Report *report) {
+    FdHandle handle(open("/dev/null", O_WRONLY | O_CLOEXEC));
+    std::string big(16384, 'x');
+
+    u64 start = bench::nowNs();
+    for (u32 i = 0; i < BENCH_PRINT_ROUNDS; i++) {
+        handle.print("[INF] request %u done in %.3f ms\n", i, i * 0.001);
+    }
+    report->add("print_short",
+        static_cast<double>(bench::nowNs() - start) / BENCH_PRINT_ROUNDS,
+        "ns/op");
+    start = bench::nowNs();
+    for (u32 i = 0; i < BENCH_PRINT_ROUNDS; i++) {
+        handle.print("%s %u\n", big.c_str(), i);
+    }
+    report->add("print_16k",
+        static_cast<double>(bench::nowNs() - start) / BENCH_PRINT_ROUNDS,
+        "ns/op");
+}
+
+int app_main(int argc, char *argv[]) {
+    bench::Report report("format");
+
+    benchFormat(&report);
+    benchPrint(&report);
+    report.print();
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <platform/handle.hpp>
+#include <platform/handle_int.hpp>
+#include "bench.hpp"
+
+/// The number of drains of a benchmark.
+#define BENCH_DRAIN_ROUNDS 20000
+/// The number of bytes written to the pipe before a drain.
+#define BENCH_DRAIN_SIZE 16384
+/// The size of a read of a drain.
+#define BENCH_READ_SIZE 4096
+/// The number of reads on the empty pipe.
+#define BENCH_EMPTY_ROUNDS 200000
+
+using platform::Handle;
+using platform::IoResult;
+
+/**
+ * @brief A handle of an opened file descriptor.
+*/
+class FdHandle: public Handle {
+ public:
+    explicit FdHandle(int fd) {
+        priv->fd = fd;
+    }
+};
+
+/**
+ * @brief Drain the handle with read(), until it throws ERR_AGAIN.
+ * @return the number of bytes read.
+*/
+static size_t drainThrow(Handle *handle, char *buf) {
+    size_t total = 0;
+    for (;;) {
+        try {
+            total += handle->read(buf, BENCH_READ_SIZE);
+        } catch (platform::HandleException &) {
+            break;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Drain the handle with tryRead(), until it returns ERR_AGAIN.
+ * @return the number of bytes read.
+*/
+static size_t drainTry(Handle *handle, char *buf) {
+    size_t total = 0;
+    for (;;) {
+        IoResult result = handle->tryRead(buf, BENCH_READ_SIZE);
+        if (result.err != common::ERR_OK || result.len == 0) {
+            break;
+        }
+        total += result.len;
+    }
+    return total;
+}
+
+int app_main(int argc, char *argv[]) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        return 1;
+    }
+    FdHandle rh(fds[0]);
+    FdHandle wh(fds[1]);
+    std::vector<char> data(BENCH_DRAIN_SIZE, 'x');
+    char buf[BENCH_READ_SIZE];
+    bench::Report report("handle");
+
+    struct Mode {
+        const char *drain;
+        const char *empty;
+        size_t (*run)(Handle *handle, char *buf);
+    };
+    static const Mode modes[] = {
+        {"throw_drain_ns", "throw_empty_ns", drainThrow},
+        {"try_drain_ns", "try_empty_ns", drainTry},
+    };
+    for (size_t m = 0; m < ARRAY_LEN(modes); m++) {
+        std::vector<u64> samples;
+        for (u32 i = 0; i < BENCH_DRAIN_ROUNDS; i++) {
+            wh.write(&data[0], data.size());
+            u64 start = bench::nowNs();
+            size_t n = modes[m].run(&rh, buf);
+            samples.push_back(bench::nowNs() - start);
+            if (n != data.size()) {
+                return 1;
+            }
+        }
+        report.add(modes[m].drain,
+            static_cast<double>(bench::percentile(&samples, 50)), "ns");
+
+        // Every read of the empty pipe fails with EAGAIN.
+        u64 start = bench::nowNs();
+        for (u32 i = 0; i < BENCH_EMPTY_ROUNDS; i++) {
+            modes[m].run(&rh, buf);
+        }
+        report.add(modes[m].empty,
+            static_cast<double>(bench::nowNs() - start) / BENCH_EMPTY_ROUNDS,
+            "ns");
+    }
+    report.print();
+    return 0;
+}
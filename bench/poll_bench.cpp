@@ -0,0 +1,686 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <common/timer_wheel.hpp>
+#include <platform/poll.hpp>
+#include <platform/poll_group.hpp>
+#include <platform/handle_int.hpp>
+#include "bench.hpp"
+
+/// The number of round trips of the ping-pong benchmark.
+#define BENCH_PINGPONG_ROUNDS 20000
+/// The duration of a throughput benchmark in nanoseconds.
+#define BENCH_DURATION_NS 200000000ULL
+/// The number of active handles of the scaling benchmark.
+#define BENCH_ACTIVE_NUM 16
+/// The number of handles of the churn benchmark.
+#define BENCH_CHURN_NUM 1000
+/// The number of timers of the timer benchmark.
+#define BENCH_TIMER_NUM 1000000
+/// The number of calls of the dispatch benchmark.
+#define BENCH_DISPATCH_ROUNDS 100000000
+/// The number of threads calling wakeup() or post() in the stress test.
+#define BENCH_WAKEUP_THREADS 4
+/// The number of client threads of the accept benchmark.
+#define BENCH_CLIENT_NUM 2
+/// The number of sockets accepted by one call.
+#define BENCH_ACCEPT_BATCH 64
+
+using platform::Handle;
+using platform::Poll;
+using platform::PollGroup;
+using platform::SocketHandle;
+
+/**
+ * @brief A handle of an opened file descriptor.
+*/
+class FdHandle: public Handle {
+ public:
+    explicit FdHandle(int fd) {
+        priv->fd = fd;
+    }
+};
+
+static const char *getBackendName(Poll::Backend backend) {
+    return backend == Poll::B_URING ? "uring" : "epoll";
+}
+
+/**
+ * @brief Create a pair of connected handles.
+*/
+static void createPair(bool socket, FdHandle **in, FdHandle **out) {
+    int fds[2];
+    int ret = socket ? socketpair(AF_UNIX, SOCK_STREAM, 0, fds) : pipe(fds);
+    if (ret < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    *in = new FdHandle(fds[0]);
+    *out = new FdHandle(fds[1]);
+}
+
+class PingPong {
+ public:
+    Poll *poll;
+    Poll *peerPoll;
+    FdHandle *in;
+    FdHandle *out;
+    FdHandle *peerIn;
+    FdHandle *peerOut;
+    std::atomic<bool> stop;
+    u64 sent;
+    int rounds;
+    std::vector<u64> rtts;
+};
+
+static void *pingPongPeer(void *arg) {
+    PingPong *pp = static_cast<PingPong *>(arg);
+    while (!pp->stop.load()) {
+        pp->peerPoll->polling(-1);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Measure the round trip time between two polls in two threads.
+*/
+static void benchPingPong(bench::Report *report, Poll::Backend backend,
+    bool socket) {
+    PingPong pp;
+    pthread_t tid;
+    char name[64];
+    char c = 0;
+
+    pp.poll = new Poll(backend);
+    pp.peerPoll = new Poll(backend);
+    createPair(socket, &pp.peerIn, &pp.out);
+    createPair(socket, &pp.in, &pp.peerOut);
+    pp.stop = false;
+    pp.rounds = 0;
+    pp.rtts.reserve(BENCH_PINGPONG_ROUNDS);
+    pp.peerPoll->add(pp.peerIn, Poll::EV_READ, [&pp](Poll::Event, Handle *h) {
+        char buf;
+        h->read(&buf, 1);
+        pp.peerOut->write(&buf, 1);
+    });
+    pp.poll->add(pp.in, Poll::EV_READ, [&pp](Poll::Event, Handle *h) {
+        char buf;
+        h->read(&buf, 1);
+        pp.rtts.push_back(bench::nowNs() - pp.sent);
+        if (++pp.rounds < BENCH_PINGPONG_ROUNDS) {
+            pp.sent = bench::nowNs();
+            pp.out->write(&buf, 1);
+        }
+    });
+    pthread_create(&tid, nullptr, pingPongPeer, &pp);
+    pp.sent = bench::nowNs();
+    pp.out->write(&c, 1);
+    while (pp.rounds < BENCH_PINGPONG_ROUNDS) {
+        pp.poll->polling(-1);
+    }
+    pp.stop = true;
+    pp.peerPoll->wakeup();
+    pthread_join(tid, nullptr);
+
+    snprintf(name, sizeof(name), "pingpong_%s_%s_p50",
+        getBackendName(backend), socket ? "socketpair" : "pipe");
+    report->add(name, bench::percentile(&pp.rtts, 50), "ns");
+    snprintf(name, sizeof(name), "pingpong_%s_%s_p99",
+        getBackendName(backend), socket ? "socketpair" : "pipe");
+    report->add(name, bench::percentile(&pp.rtts, 99), "ns");
+
+    pp.poll->del(pp.in, Poll::EV_READ);
+    pp.peerPoll->del(pp.peerIn, Poll::EV_READ);
+    delete pp.poll;
+    delete pp.peerPoll;
+    delete pp.in;
+    delete pp.out;
+    delete pp.peerIn;
+    delete pp.peerOut;
+}
+
+/**
+ * @brief Raise the limit of file descriptors, return the number of
+ * file descriptors can be opened.
+*/
+static u32 raiseFdLimit() {
+    struct rlimit rlim;
+    getrlimit(RLIMIT_NOFILE, &rlim);
+    rlim.rlim_cur = rlim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rlim);
+    getrlimit(RLIMIT_NOFILE, &rlim);
+    return rlim.rlim_cur > 0xffffffff ? 0xffffffff :
+        static_cast<u32>(rlim.rlim_cur);
+}
+
+/**
+ * @brief Dispatch the ready events as many as possible.
+ *
+ * @return events per second.
+*/
+static double runEvents(Poll *poll, u64 *events) {
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    *events = 0;
+    do {
+        poll->polling(0);
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    return *events * 1e9 / elapsed;
+}
+
+static void countEvent(Poll::Event event, Handle *handle, void *arg) {
+    (*static_cast<u64 *>(arg))++;
+}
+
+/**
+ * @brief Measure events per second with idle and active handles.
+*/
+static void benchScaling(bench::Report *report, Poll::Backend backend,
+    u32 idle) {
+    Poll poll(backend);
+    std::vector<FdHandle *> handles;
+    u64 events;
+    char name[64];
+
+    for (u32 i = 0; i < idle + BENCH_ACTIVE_NUM; i++) {
+        int fd = eventfd(i < idle ? 0 : 1, EFD_NONBLOCK);
+        if (fd < 0) {
+            perror("eventfd");
+            exit(1);
+        }
+        handles.push_back(new FdHandle(fd));
+        poll.add(handles.back(), Poll::EV_READ, countEvent, &events);
+    }
+    double rate = runEvents(&poll, &events);
+    snprintf(name, sizeof(name), "events_%s_idle_%u_active_%u",
+        getBackendName(backend), idle, BENCH_ACTIVE_NUM);
+    report->add(name, rate, "events/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        poll.del(handles[i], Poll::EV_READ);
+        delete handles[i];
+    }
+}
+
+/**
+ * @brief A callback stored as before Poll::Callback, a function and
+ * its argument.
+*/
+class RawCallback {
+ public:
+    Poll::cb_t cb;
+    void *arg;
+};
+
+/**
+ * @brief Measure the cost of a dispatch, a table of callbacks is called
+ * in turn like the handle states are.
+*/
+static void benchDispatch(bench::Report *report) {
+    RawCallback raws[BENCH_ACTIVE_NUM];
+    Poll::Callback fns[BENCH_ACTIVE_NUM];
+    Poll::Callback lambdas[BENCH_ACTIVE_NUM];
+    u64 counter = 0;
+    u64 *events = &counter;
+    Handle *handle = nullptr;
+
+    for (u32 i = 0; i < BENCH_ACTIVE_NUM; i++) {
+        raws[i].cb = countEvent;
+        raws[i].arg = events;
+        fns[i] = Poll::Callback(countEvent, events);
+        lambdas[i] = Poll::Callback([events](Poll::Event, Handle *) {
+            (*events)++;
+        });
+    }
+    // Not to let the compiler know the callbacks and inline them.
+    __asm__ __volatile__("" ::: "memory");
+    u64 start = bench::nowNs();
+    for (u32 n = 0; n < BENCH_DISPATCH_ROUNDS; n++) {
+        RawCallback *raw = raws + n % BENCH_ACTIVE_NUM;
+        raw->cb(Poll::EV_READ, handle, raw->arg);
+    }
+    report->add("dispatch_cb_arg", static_cast<double>(bench::nowNs() -
+        start) / BENCH_DISPATCH_ROUNDS, "ns");
+    start = bench::nowNs();
+    for (u32 n = 0; n < BENCH_DISPATCH_ROUNDS; n++) {
+        fns[n % BENCH_ACTIVE_NUM](Poll::EV_READ, handle);
+    }
+    report->add("dispatch_callback_function", static_cast<double>(
+        bench::nowNs() - start) / BENCH_DISPATCH_ROUNDS, "ns");
+    start = bench::nowNs();
+    for (u32 n = 0; n < BENCH_DISPATCH_ROUNDS; n++) {
+        lambdas[n % BENCH_ACTIVE_NUM](Poll::EV_READ, handle);
+    }
+    report->add("dispatch_callback_lambda", static_cast<double>(
+        bench::nowNs() - start) / BENCH_DISPATCH_ROUNDS, "ns");
+}
+
+/**
+ * @brief Measure the dispatch rate of a function and a lambda callback.
+*/
+static void benchCallbacks(bench::Report *report) {
+    Poll poll;
+    std::vector<FdHandle *> handles;
+    u64 events;
+
+    for (u32 i = 0; i < BENCH_ACTIVE_NUM; i++) {
+        handles.push_back(new FdHandle(eventfd(1, EFD_NONBLOCK)));
+        poll.add(handles.back(), Poll::EV_READ, countEvent, &events);
+    }
+    report->add("callback_function", runEvents(&poll, &events), "events/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        u64 *counter = &events;
+        poll.mod(handles[i], Poll::EV_READ, [counter](Poll::Event, Handle *) {
+            (*counter)++;
+        });
+    }
+    report->add("callback_lambda", runEvents(&poll, &events), "events/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        poll.del(handles[i], Poll::EV_READ);
+        delete handles[i];
+    }
+}
+
+/**
+ * @brief Measure the rate of add() and del().
+ *
+ * @param flush is true to call polling() after each add() and del(),
+ * so the changes are not coalesced.
+*/
+static void benchChurn(bench::Report *report, Poll::Backend backend,
+    bool flush) {
+    Poll poll(backend);
+    std::vector<FdHandle *> handles;
+    u64 events = 0;
+    u64 ops = 0;
+    char name[64];
+
+    for (u32 i = 0; i < BENCH_CHURN_NUM; i++) {
+        handles.push_back(new FdHandle(eventfd(0, EFD_NONBLOCK)));
+    }
+    for (size_t i = 0; i < handles.size(); i++) {
+        poll.add(handles[i], Poll::EV_READ, countEvent, &events);
+    }
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    do {
+        for (size_t i = 0; i < handles.size(); i++) {
+            poll.add(handles[i], Poll::EV_WRITE, countEvent, &events);
+        }
+        if (flush) {
+            poll.polling(0);
+        }
+        for (size_t i = 0; i < handles.size(); i++) {
+            poll.del(handles[i], Poll::EV_WRITE);
+        }
+        poll.polling(0);
+        ops += 2 * handles.size();
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    snprintf(name, sizeof(name), "churn_%s_%s", getBackendName(backend),
+        flush ? "flushed" : "coalesced");
+    report->add(name, ops * 1e9 / elapsed, "ops/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        poll.del(handles[i], Poll::EV_READ);
+        delete handles[i];
+    }
+}
+
+/**
+ * @brief Measure the rate of mod().
+*/
+static void benchMod(bench::Report *report, Poll::Backend backend) {
+    Poll poll(backend);
+    std::vector<FdHandle *> handles;
+    u64 ops = 0;
+    u64 start;
+    u64 elapsed;
+    char name[64];
+
+    for (u32 i = 0; i < BENCH_CHURN_NUM; i++) {
+        handles.push_back(new FdHandle(eventfd(0, EFD_NONBLOCK)));
+        poll.add(handles.back(), Poll::EV_READ, countEvent, &ops);
+    }
+    start = bench::nowNs();
+    do {
+        for (size_t i = 0; i < handles.size(); i++) {
+            poll.mod(handles[i], Poll::EV_READ, countEvent, &ops);
+        }
+        ops += handles.size();
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    snprintf(name, sizeof(name), "mod_%s", getBackendName(backend));
+    report->add(name, ops * 1e9 / elapsed, "ops/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        poll.del(handles[i], Poll::EV_READ);
+        delete handles[i];
+    }
+}
+
+static void countTimer(common::Timer *timer, void *arg) {
+    (*static_cast<u64 *>(arg))++;
+}
+
+/**
+ * @brief Measure the rate of adding and expiring timers.
+*/
+static void benchTimers(bench::Report *report) {
+    std::vector<common::Timer> timers(BENCH_TIMER_NUM);
+    common::TimerWheel wheel(0);
+    u64 fired = 0;
+    u64 start;
+
+    srand(1);
+    start = bench::nowNs();
+    for (size_t i = 0; i < timers.size(); i++) {
+        wheel.add(&timers[i], rand() % 60000, countTimer, &fired);
+    }
+    report->add("timer_add", timers.size() * 1e9 / (bench::nowNs() - start),
+        "ops/s");
+    start = bench::nowNs();
+    for (u64 now = 0; now <= 60000; now++) {
+        wheel.run(now);
+    }
+    report->add("timer_expire", fired * 1e9 / (bench::nowNs() - start),
+        "timers/s");
+    for (size_t i = 0; i < timers.size(); i++) {
+        wheel.add(&timers[i], rand() % 60000 + 60001, countTimer, &fired);
+    }
+    start = bench::nowNs();
+    for (size_t i = 0; i < timers.size(); i++) {
+        wheel.del(&timers[i]);
+    }
+    report->add("timer_del", timers.size() * 1e9 / (bench::nowNs() - start),
+        "ops/s");
+}
+
+static void countTask(void *arg) {
+    (*static_cast<u64 *>(arg))++;
+}
+
+class PostCtx {
+ public:
+    Poll *poll;
+    u64 tasks;
+    std::atomic<bool> stop;
+};
+
+static void *postLoop(void *arg) {
+    PostCtx *ctx = static_cast<PostCtx *>(arg);
+    while (!ctx->stop.load(std::memory_order_relaxed)) {
+        ctx->poll->post(countTask, &ctx->tasks);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Measure the rate of tasks posted from another thread.
+*/
+static void benchPost(bench::Report *report) {
+    PostCtx ctx;
+    pthread_t tid;
+    Poll poll;
+
+    ctx.poll = &poll;
+    ctx.tasks = 0;
+    ctx.stop = false;
+    pthread_create(&tid, nullptr, postLoop, &ctx);
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    do {
+        poll.polling(10);
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    ctx.stop = true;
+    pthread_join(tid, nullptr);
+    report->add("post_cross_thread", ctx.tasks * 1e9 / elapsed, "tasks/s");
+    poll.polling(0);
+}
+
+static void *wakeupLoop(void *arg) {
+    PostCtx *ctx = static_cast<PostCtx *>(arg);
+    while (!ctx->stop.load(std::memory_order_relaxed)) {
+        ctx->poll->wakeup();
+    }
+    return nullptr;
+}
+
+static void *postYieldLoop(void *arg) {
+    PostCtx *ctx = static_cast<PostCtx *>(arg);
+    while (!ctx->stop.load(std::memory_order_relaxed)) {
+        // Let the task stack become empty, so post() wakes up the poll.
+        ctx->poll->post(countTask, &ctx->tasks);
+        sched_yield();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Stress wakeup() and post() from several threads against
+ * polling(-1), a lost wakeup hangs the benchmark.
+*/
+static void benchWakeupStress(bench::Report *report) {
+    pthread_t tids[BENCH_WAKEUP_THREADS];
+    PostCtx ctx;
+    Poll poll;
+    u64 done = 0;
+
+    ctx.poll = &poll;
+    ctx.tasks = 0;
+    ctx.stop = false;
+    for (int i = 0; i < BENCH_WAKEUP_THREADS; i++) {
+        pthread_create(&tids[i], nullptr, i % 2 ? wakeupLoop : postYieldLoop,
+            &ctx);
+    }
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    do {
+        poll.polling(-1);
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    ctx.stop = true;
+    for (int i = 0; i < BENCH_WAKEUP_THREADS; i++) {
+        pthread_join(tids[i], nullptr);
+    }
+    // The poll must still be woken up by a post() after the storm.
+    poll.post(countTask, &done);
+    while (!done) {
+        poll.polling(-1);
+    }
+    report->add("post_wakeup_stress", ctx.tasks * 1e9 / elapsed, "tasks/s");
+}
+
+/**
+ * @brief Measure events per second of a poll group.
+*/
+static void benchGroup(bench::Report *report, u32 threads) {
+    PollGroup group(threads);
+    std::vector<FdHandle *> handles;
+    std::vector<u64> counters(threads * 8);
+    char name[64];
+
+    for (u32 i = 0; i < threads * BENCH_ACTIVE_NUM; i++) {
+        u32 idx = i % threads;
+        handles.push_back(new FdHandle(eventfd(1, EFD_NONBLOCK)));
+        // The counters are 64 bytes apart, not to share a cache line.
+        group.getPoll(idx)->add(handles.back(), Poll::EV_READ, countEvent,
+            &counters[idx * 8]);
+    }
+    group.start();
+    u64 start = bench::nowNs();
+    usleep(BENCH_DURATION_NS / 1000);
+    group.stop();
+    u64 elapsed = bench::nowNs() - start;
+    u64 events = 0;
+    for (u32 i = 0; i < threads; i++) {
+        events += counters[i * 8];
+    }
+    snprintf(name, sizeof(name), "group_%u_threads", threads);
+    report->add(name, events * 1e9 / elapsed, "events/s");
+    for (size_t i = 0; i < handles.size(); i++) {
+        group.getPoll(i % threads)->del(handles[i], Poll::EV_READ);
+        delete handles[i];
+    }
+}
+
+/**
+ * @brief A listener shared by the polls of a group.
+*/
+class AcceptCtx {
+ public:
+    AcceptCtx(): listener(SocketHandle::D_IPV4, SocketHandle::S_TCP),
+        accepted(0), stop(false) {}
+
+    SocketHandle listener;
+    std::atomic<u64> accepted;
+    std::atomic<bool> stop;
+};
+
+static void onGroupAccept(Poll::Event event, Handle *handle, void *arg) {
+    AcceptCtx *ctx = static_cast<AcceptCtx *>(arg);
+    SocketHandle *conns[BENCH_ACCEPT_BATCH];
+    size_t num;
+
+    do {
+        num = ctx->listener.accept(conns, BENCH_ACCEPT_BATCH);
+        for (size_t i = 0; i < num; i++) {
+            delete conns[i];
+        }
+        ctx->accepted.fetch_add(num, std::memory_order_relaxed);
+    } while (num == BENCH_ACCEPT_BATCH);
+}
+
+static void *connectLoop(void *arg) {
+    AcceptCtx *ctx = static_cast<AcceptCtx *>(arg);
+    struct sockaddr_in sin = {};
+    struct linger lg = {1, 0};
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(ctx->listener.getLocalPort());
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (!ctx->stop.load(std::memory_order_relaxed)) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // Reset instead of TIME_WAIT, not to run out of the local ports.
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        connect(fd, reinterpret_cast<struct sockaddr *>(&sin), sizeof(sin));
+        close(fd);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Measure connections per second accepted by a poll group
+ * sharing one listener.
+*/
+static void benchGroupAccept(bench::Report *report, u32 threads) {
+    platform::net::Addr4 loopback(INADDR_LOOPBACK);
+    pthread_t clients[BENCH_CLIENT_NUM];
+    PollGroup group(threads);
+    AcceptCtx ctx;
+    char name[64];
+
+    ctx.listener.setOption(SocketHandle::O_REUSE_ADDR, 1);
+    ctx.listener.bind(&loopback, 0);
+    ctx.listener.listen(1024);
+    group.addShared(&ctx.listener, Poll::EV_READ, onGroupAccept, &ctx);
+    group.start();
+    for (int i = 0; i < BENCH_CLIENT_NUM; i++) {
+        pthread_create(&clients[i], nullptr, connectLoop, &ctx);
+    }
+    u64 start = bench::nowNs();
+    usleep(BENCH_DURATION_NS / 1000);
+    u64 accepted = ctx.accepted.load(std::memory_order_relaxed);
+    u64 elapsed = bench::nowNs() - start;
+    ctx.stop = true;
+    for (int i = 0; i < BENCH_CLIENT_NUM; i++) {
+        pthread_join(clients[i], nullptr);
+    }
+    group.stop();
+    for (u32 i = 0; i < threads; i++) {
+        group.getPoll(i)->del(&ctx.listener, Poll::EV_READ);
+    }
+    snprintf(name, sizeof(name), "group_%u_threads_accept", threads);
+    report->add(name, accepted * 1e9 / elapsed, "conns/s");
+}
+
+int app_main(int argc, char *argv[]) {
+    static const u32 idles[] = {1000, 10000, 100000};
+    static const Poll::Backend backends[] = {Poll::B_DEFAULT, Poll::B_URING};
+    bench::Report report("poll");
+    u32 maxFds = raiseFdLimit();
+
+    for (size_t b = 0; b < ARRAY_LEN(backends); b++) {
+        Poll poll(backends[b]);
+        if (poll.getBackend() != backends[b]) {
+            continue;
+        }
+        benchPingPong(&report, backends[b], false);
+        benchPingPong(&report, backends[b], true);
+        for (size_t i = 0; i < ARRAY_LEN(idles); i++) {
+            // Leave some file descriptors to the others.
+            u32 idle = idles[i];
+            if (idle + BENCH_ACTIVE_NUM + 64 > maxFds) {
+                idle = maxFds - BENCH_ACTIVE_NUM - 64;
+            }
+            benchScaling(&report, backends[b], idle);
+            if (idle != idles[i]) {
+                break;
+            }
+        }
+        benchChurn(&report, backends[b], false);
+        benchChurn(&report, backends[b], true);
+        benchMod(&report, backends[b]);
+    }
+    benchDispatch(&report);
+    benchCallbacks(&report);
+    benchTimers(&report);
+    benchPost(&report);
+    benchWakeupStress(&report);
+    // Scale the group from 1 thread to the number of CPUs.
+    long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+    u32 maxThreads = cpuNum > 1 ? static_cast<u32>(cpuNum) : 1;
+    for (u32 threads = 1;; threads *= 2) {
+        if (threads > maxThreads) {
+            threads = maxThreads;
+        }
+        benchGroup(&report, threads);
+        benchGroupAccept(&report, threads);
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+    report.print();
+    return 0;
+}
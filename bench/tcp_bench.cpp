@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstdio>
+#include <platform/handle.hpp>
+#include <platform/poll.hpp>
+#include "bench.hpp"
+
+/// The duration of a benchmark in nanoseconds.
+#define BENCH_DURATION_NS 200000000ULL
+/// The number of client threads generating connections.
+#define BENCH_CLIENT_NUM 2
+/// The number of sockets accepted by one call in the batch mode.
+#define BENCH_ACCEPT_BATCH 64
+
+using platform::Handle;
+using platform::Poll;
+using platform::SocketHandle;
+
+/**
+ * @brief A client thread connecting to the port until stopped.
+*/
+class Client {
+ public:
+    Client(): port(0), stop(nullptr) {}
+
+    u16 port;
+    std::atomic<bool> *stop;
+    pthread_t tid;
+};
+
+static void *clientLoop(void *arg) {
+    Client *client = static_cast<Client *>(arg);
+    struct sockaddr_in sin = {};
+    struct linger lg = {1, 0};
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(client->port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (!client->stop->load(std::memory_order_relaxed)) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // Reset instead of TIME_WAIT, not to run out of the local ports.
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        connect(fd, reinterpret_cast<struct sockaddr *>(&sin), sizeof(sin));
+        close(fd);
+    }
+    return nullptr;
+}
+
+class Server {
+ public:
+    Server(): listener(SocketHandle::D_IPV4, SocketHandle::S_TCP),
+        batch(false), accepted(0), calls(0) {}
+
+    SocketHandle listener;
+    bool batch;
+    u64 accepted;
+    u64 calls;      ///< the number of the accept callbacks
+};
+
+static void onAccept(Poll::Event event, Handle *handle, void *arg) {
+    Server *server = static_cast<Server *>(arg);
+    SocketHandle *handles[BENCH_ACCEPT_BATCH];
+    size_t num;
+
+    server->calls++;
+    if (!server->batch) {
+        // One connection for each event.
+        SocketHandle *conn = server->listener.accept();
+        if (conn) {
+            server->accepted++;
+            delete conn;
+        }
+        return;
+    }
+    do {
+        num = server->listener.accept(handles, BENCH_ACCEPT_BATCH);
+        for (size_t i = 0; i < num; i++) {
+            delete handles[i];
+        }
+        server->accepted += num;
+    } while (num == BENCH_ACCEPT_BATCH);
+}
+
+/**
+ * @brief Measure the accepted connections per second.
+*/
+static void benchAccept(bench::Report *report, bool batch) {
+    platform::net::Addr4 loopback(INADDR_LOOPBACK);
+    Client clients[BENCH_CLIENT_NUM];
+    std::atomic<bool> stop(false);
+    Server server;
+    Poll poll;
+    char name[64];
+
+    server.batch = batch;
+    server.listener.setOption(SocketHandle::O_REUSE_ADDR, 1);
+    server.listener.bind(&loopback, 0);
+    server.listener.listen(1024);
+    poll.add(&server.listener, Poll::EV_READ, onAccept, &server);
+    for (int i = 0; i < BENCH_CLIENT_NUM; i++) {
+        clients[i].port = server.listener.getLocalPort();
+        clients[i].stop = &stop;
+        pthread_create(&clients[i].tid, nullptr, clientLoop, clients + i);
+    }
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    do {
+        poll.polling(10);
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+    stop = true;
+    for (int i = 0; i < BENCH_CLIENT_NUM; i++) {
+        pthread_join(clients[i].tid, nullptr);
+    }
+    poll.del(&server.listener, Poll::EV_READ);
+
+    snprintf(name, sizeof(name), "accept_%s", batch ? "batch" : "single");
+    report->add(name, server.accepted * 1e9 / elapsed, "conns/s");
+    snprintf(name, sizeof(name), "accept_%s_per_wakeup",
+        batch ? "batch" : "single");
+    report->add(name, server.calls ?
+        static_cast<double>(server.accepted) / server.calls : 0, "conns");
+}
+
+int app_main(int argc, char *argv[]) {
+    bench::Report report("tcp");
+
+    benchAccept(&report, false);
+    benchAccept(&report, true);
+    report.print();
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <netinet/in.h>
+#include <cstdio>
+#include <cstring>
+#include <platform/handle.hpp>
+#include "bench.hpp"
+
+/// The duration of a benchmark in nanoseconds.
+#define BENCH_DURATION_NS 200000000ULL
+/// The number of datagrams sent in a burst.
+#define BENCH_BURST 64
+/// The size of a datagram.
+#define BENCH_DGRAM_SIZE 1200
+/// The number of datagrams in a GSO buffer, a buffer is up to 64K.
+#define BENCH_GSO_SEGS 32
+
+using platform::HandleException;
+using platform::SocketHandle;
+
+typedef SocketHandle::Datagram Datagram;
+
+enum Mode {
+    M_SINGLE,       ///< a write() and a read() for each datagram
+    M_BATCH,        ///< sendBatch() and recvBatch()
+    M_GSO,          ///< a GSO buffer and recvBatch() with GRO
+};
+
+static const char *modeNames[] = {"single", "batch", "gso_gro"};
+
+/**
+ * @brief Send a burst of datagrams.
+*/
+static void sendBurst(SocketHandle *tx, Mode mode, char *buf) {
+    Datagram msgs[BENCH_BURST];
+
+    switch (mode) {
+    case M_SINGLE:
+        for (int i = 0; i < BENCH_BURST; i++) {
+            tx->write(buf + i * BENCH_DGRAM_SIZE, BENCH_DGRAM_SIZE);
+        }
+        break;
+    case M_BATCH:
+        for (int i = 0; i < BENCH_BURST; i++) {
+            msgs[i].buf = buf + i * BENCH_DGRAM_SIZE;
+            msgs[i].len = BENCH_DGRAM_SIZE;
+            msgs[i].port = 0;
+            msgs[i].segSize = 0;
+        }
+        for (size_t sent = 0; sent < BENCH_BURST;) {
+            sent += tx->sendBatch(msgs + sent, BENCH_BURST - sent);
+        }
+        break;
+    case M_GSO:
+        for (int i = 0; i < BENCH_BURST / BENCH_GSO_SEGS; i++) {
+            msgs[i].buf = buf + i * BENCH_GSO_SEGS * BENCH_DGRAM_SIZE;
+            msgs[i].len = BENCH_GSO_SEGS * BENCH_DGRAM_SIZE;
+            msgs[i].port = 0;
+            msgs[i].segSize = BENCH_DGRAM_SIZE;
+        }
+        for (size_t sent = 0; sent < BENCH_BURST / BENCH_GSO_SEGS;) {
+            sent += tx->sendBatch(msgs + sent,
+                BENCH_BURST / BENCH_GSO_SEGS - sent);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Receive a burst of datagrams.
+ *
+ * @return the number of datagrams received.
+*/
+static u64 recvBurst(SocketHandle *rx, Mode mode, char *buf) {
+    Datagram msgs[BENCH_BURST];
+    u64 num = 0;
+
+    if (mode == M_SINGLE) {
+        for (int i = 0; i < BENCH_BURST; i++) {
+            try {
+                rx->read(buf, BENCH_BURST * BENCH_DGRAM_SIZE);
+            } catch (HandleException &e) {
+                break;
+            }
+            num++;
+        }
+        return num;
+    }
+    // A GRO datagram holds up to 64K.
+    size_t size = mode == M_GSO ? 65536 : BENCH_DGRAM_SIZE;
+    for (int i = 0; i < BENCH_BURST; i++) {
+        msgs[i].buf = buf + i * size;
+        msgs[i].len = size;
+    }
+    for (;;) {
+        size_t n = rx->recvBatch(msgs, BENCH_BURST);
+        for (size_t i = 0; i < n; i++) {
+            num += msgs[i].segSize ?
+                (msgs[i].len + msgs[i].segSize - 1) / msgs[i].segSize : 1;
+        }
+        if (n < BENCH_BURST) {
+            break;
+        }
+    }
+    return num;
+}
+
+/**
+ * @brief Measure the datagrams per second sent and received on loopback.
+*/
+static void benchUdp(bench::Report *report, Mode mode) {
+    static char sbuf[BENCH_BURST * BENCH_DGRAM_SIZE];
+    static char rbuf[BENCH_BURST * 65536];
+    platform::net::Addr4 loopback(INADDR_LOOPBACK);
+    SocketHandle rx(SocketHandle::D_IPV4, SocketHandle::S_UDP);
+    SocketHandle tx(SocketHandle::D_IPV4, SocketHandle::S_UDP);
+    char name[64];
+    u64 packets = 0;
+
+    rx.setOption(SocketHandle::O_RECV_BUF, 8 << 20);
+    rx.bind(&loopback, 0);
+    if (mode == M_GSO) {
+        try {
+            rx.setOption(SocketHandle::O_UDP_GRO, 1);
+            tx.setOption(SocketHandle::O_UDP_SEGMENT, BENCH_DGRAM_SIZE);
+        } catch (HandleException &e) {
+            return;
+        }
+    }
+    tx.connect(&loopback, rx.getLocalPort());
+    memset(sbuf, 'u', sizeof(sbuf));
+
+    u64 start = bench::nowNs();
+    u64 elapsed;
+    do {
+        sendBurst(&tx, mode, sbuf);
+        packets += recvBurst(&rx, mode, rbuf);
+        elapsed = bench::nowNs() - start;
+    } while (elapsed < BENCH_DURATION_NS);
+
+    snprintf(name, sizeof(name), "udp_%s", modeNames[mode]);
+    report->add(name, packets * 1e9 / elapsed, "packets/s");
+}
+
+int app_main(int argc, char *argv[]) {
+    bench::Report report("udp");
+
+    benchUdp(&report, M_SINGLE);
+    benchUdp(&report, M_BATCH);
+    benchUdp(&report, M_GSO);
+    report.print();
+    return 0;
+}
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <deque>
+#include <common/exception.hpp>
+#include <platform/handle.hpp>
+
+/**
+ * @file buffer_chain.hpp
+ * @brief Chain of reference-counted buffers.
+*/
+
+namespace common {
+
+/// Only used by class BufferChain.
+class BufferBlock;
+
+/**
+ * @brief A chain of segments of reference-counted blocks.
+ * @details The data is copied only when it's appended from the memory or
+ * read from a handle. Slicing, splitting and appending a chain share the
+ * blocks, so the frames can be split and forwarded without copying.
+ * A chain is used by one thread, the blocks can be shared between
+ * the chains of different threads.
+*/
+class BufferChain {
+ public:
+    /**
+     * @param blockSize is the size of the blocks allocated by the chain
+    */
+    explicit BufferChain(size_t blockSize = 16384);
+
+    ~BufferChain();
+
+    /**
+     * @brief Get the length of the data.
+    */
+    size_t getLength() const {
+        return length;
+    }
+
+    /**
+     * @brief Get the number of the segments.
+    */
+    size_t getSegmentNum() const {
+        return segs.size();
+    }
+
+    /**
+     * @brief Copy data to the end of the chain.
+    */
+    void append(const void *buf, size_t len);
+
+    /**
+     * @brief Append the data of another chain, the blocks are shared.
+    */
+    void append(const BufferChain &chain);
+
+    /**
+     * @brief Copy data to the front of the chain, it uses the room before
+     * the first segment if it's not shared.
+    */
+    void prepend(const void *buf, size_t len);
+
+    /**
+     * @brief Get a range of the data, the blocks are shared.
+     *
+     * @param offset is the offset of the range
+     * @param len is the length of the range
+     * @param out is the chain to append the range to
+    */
+    void slice(size_t offset, size_t len, BufferChain *out) const;
+
+    /**
+     * @brief Move the data at the front to another chain.
+     *
+     * @param len is the length of the data to move
+     * @param out is the chain to append the data to
+    */
+    void split(size_t len, BufferChain *out);
+
+    /**
+     * @brief Drop the data at the front.
+    */
+    void consume(size_t len);
+
+    /**
+     * @brief Drop all the data.
+    */
+    void clear();
+
+    /**
+     * @brief Make the data at the front contiguous.
+     * @details The data is copied only if it's in more than one segment.
+     *
+     * @param len is the length of the data, not larger than getLength()
+     * @return a pointer to the data.
+    */
+    const void *coalesce(size_t len);
+
+    /**
+     * @brief Copy the data to the memory.
+     *
+     * @param buf is the buffer to store the data
+     * @param len is the length of the buffer
+     * @param offset is the offset of the data to copy
+     * @return the number of bytes copied.
+    */
+    size_t copyOut(void *buf, size_t len, size_t offset = 0) const;
+
+    /**
+     * @brief Get the segments as I/O vectors.
+     *
+     * @param iov is the array to store the segments
+     * @param num is the length of the array
+     * @return the number of the segments stored.
+    */
+    size_t getIoVecs(platform::IoVec *iov, size_t num) const;
+
+    /**
+     * @brief Read data from a handle to the end of the chain.
+     * @details The data is read into the room after the last segment and
+     * a new block with one readv(), HandleException is thrown as is.
+     *
+     * @param handle is the handle to read
+     * @param len is the maximum number of bytes to read
+     * @return the number of bytes read.
+    */
+    size_t readFrom(platform::Handle *handle, size_t len);
+
+    /**
+     * @brief Write the data at the front to a handle with one writev(),
+     * the data written is consumed. HandleException is thrown as is.
+     *
+     * @return the number of bytes written.
+    */
+    size_t writeTo(platform::Handle *handle);
+
+ private:
+    explicit BufferChain(BufferChain const &);  /// not need to implement
+    BufferChain &operator = (const BufferChain &);  /// not need to implement
+
+    /**
+     * @brief A range of a block.
+    */
+    struct Segment {
+        BufferBlock *block;
+        char *data;
+        size_t len;
+    };
+
+    /**
+     * @brief Get the room after the last segment if it's writable.
+     *
+     * @param len retrieves the length of the room
+     * @return the start of the room, nullptr if no room.
+    */
+    char *getTailRoom(size_t *len);
+
+    /**
+     * @brief Get a new block, the spare block is used first.
+    */
+    BufferBlock *newBlock(size_t size);
+
+    /**
+     * @brief Keep an unused block as the spare block.
+    */
+    void keepBlock(BufferBlock *block);
+
+    std::deque<Segment> segs;
+    size_t length;
+    size_t blockSize;
+    BufferBlock *spare;     ///< a block kept to read into
+};
+
+typedef ObjectException<BufferChain> BufferChainException;
+
+}  // namespace common
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <common/exception.hpp>
+#include <platform/handle.hpp>
+
+/**
+ * @file buffered_handle.hpp
+ * @brief Handle with userspace read and write buffers.
+*/
+
+namespace common {
+
+/**
+ * @brief A handle wrapper buffering the reads and the writes.
+ * @details The reads are served from a read-ahead buffer, which is filled
+ * with one read of the handle. The writes are coalesced in a write buffer
+ * until it's full or flush() is called. A read or write larger than
+ * the buffer skips it.
+ *
+ * The errors of the handle are thrown as is, the buffered data is kept,
+ * so a non-blocking handle can be retried after ERR_AGAIN.
+*/
+class BufferedHandle {
+ public:
+    /**
+     * @param handle is the handle to wrap, it's not deleted by the wrapper
+     * @param readSize is the size of the read buffer
+     * @param writeSize is the size of the write buffer
+    */
+    explicit BufferedHandle(platform::Handle *handle,
+        size_t readSize = 4096, size_t writeSize = 4096);
+
+    /**
+     * @brief The buffered writes are dropped, call flush() before.
+    */
+    ~BufferedHandle();
+
+    /**
+     * @brief Get the wrapped handle.
+    */
+    platform::Handle *getHandle() const {
+        return handle;
+    }
+
+    /**
+     * @brief Read data, from the buffer if there are buffered data.
+     *
+     * @return the number of bytes read, at least 1.
+    */
+    size_t read(void *buf, size_t len);
+
+    /**
+     * @brief Peek the buffered data without consuming it,
+     * read the handle until there are at least len bytes.
+     *
+     * @param len is the number of bytes, not larger than the read buffer
+     * @return a pointer to the buffered data.
+    */
+    const void *peek(size_t len);
+
+    /**
+     * @brief Skip the buffered data.
+     *
+     * @param len is the number of bytes, not larger than getBuffered()
+    */
+    void skip(size_t len);
+
+    /**
+     * @brief Read data until the delimiter, the delimiter is included.
+     * @details If the delimiter is not found in len bytes,
+     * len bytes are read.
+     *
+     * @param buf is the buffer to store the data
+     * @param len is the length of the buffer
+     * @param delim is the delimiter
+     * @return the number of bytes read.
+    */
+    size_t readUntil(void *buf, size_t len, char delim);
+
+    /**
+     * @brief Get the number of bytes in the read buffer.
+    */
+    size_t getBuffered() const {
+        return rend - rpos;
+    }
+
+    /**
+     * @brief Write data to the buffer, the buffer is flushed if it's full.
+     * @details All the data is accepted unless the handle fails, the error
+     * is thrown only if no data is accepted.
+     *
+     * @return the number of bytes accepted, at least 1.
+    */
+    size_t write(const void *buf, size_t len);
+
+    /**
+     * @brief Write all the buffered data to the handle.
+    */
+    void flush();
+
+    /**
+     * @brief Get the number of bytes in the write buffer.
+    */
+    size_t getPending() const {
+        return wend - wpos;
+    }
+
+ private:
+    explicit BufferedHandle(BufferedHandle const &);  /// not implement
+    BufferedHandle &operator = (const BufferedHandle &);  /// not implement
+
+    /**
+     * @brief Read the handle once to fill the read buffer.
+    */
+    void fill();
+
+    platform::Handle *handle;
+    char *rbuf;
+    size_t rsize;
+    size_t rpos;        ///< start of the buffered data
+    size_t rend;        ///< end of the buffered data
+    char *wbuf;
+    size_t wsize;
+    size_t wpos;        ///< start of the pending data
+    size_t wend;        ///< end of the pending data
+};
+
+typedef ObjectException<BufferedHandle> BufferedHandleException;
+
+}  // namespace common
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <platform/type.hpp>
+#include <platform/args.hpp>
+
+/**
+ * @file format.hpp
+ * @brief Common string formatting.
+*/
+
+namespace common {
+
+/**
+ * @brief A growable buffer of formatted strings.
+ * @details The formatting supports the printf() conversions, the output is
+ * never truncated. The integers, strings and the usual floating-point
+ * conversions are formatted without the C library, the others fall back
+ * to it. The memory is kept when the buffer is cleared, so a reused
+ * buffer doesn't allocate.
+*/
+class FormatBuffer {
+ public:
+    FormatBuffer(): buf(nullptr), len(0), cap(0) {}
+
+    ~FormatBuffer();
+
+    /**
+     * @brief Append a formatted string.
+     *
+     * @param fmt is the format string.(see printf() in C library)
+    */
+    void format(const char *fmt, ...) ARGS_FORMAT(2, 3);
+
+    /**
+     * @brief Append a formatted string.
+     *
+     * @param fmt is the format string.(see printf() in C library)
+     * @param args is the arguments
+    */
+    void vformat(const char *fmt, va_list args);
+
+    /**
+     * @brief Append a string.
+    */
+    void append(const char *str, size_t n);
+
+    /**
+     * @brief Append a character n times.
+    */
+    void fill(char c, size_t n);
+
+    /**
+     * @brief Get the string, it's terminated by '\0'.
+    */
+    const char *getData() const {
+        return buf ? buf : "";
+    }
+
+    /**
+     * @brief Get the length of the string.
+    */
+    size_t getLength() const {
+        return len;
+    }
+
+    /**
+     * @brief Clear the string, the memory is kept.
+    */
+    void clear() {
+        len = 0;
+        if (buf) {
+            buf[0] = '\0';
+        }
+    }
+
+ private:
+    explicit FormatBuffer(FormatBuffer const &);  /// not need to implement
+    FormatBuffer &operator = (const FormatBuffer &);  /// not need to implement
+
+    /**
+     * @brief Make room for n more characters and the terminator.
+     *
+     * @return the end of the string.
+    */
+    char *reserve(size_t n) {
+        if (len + n + 1 > cap) {
+            grow(len + n + 1);
+        }
+        return buf + len;
+    }
+
+    void grow(size_t size);
+
+    void formatInt(int flags, int width, int prec,
+        u64 value, bool neg, int conv);
+    void formatStr(int flags, int width, int prec, const char *str);
+    bool formatFloat(int flags, int width, int prec, double value);
+    void formatFloatLib(int flags, int width, int prec, int conv,
+        double value);
+    void formatFloatLib(int flags, int width, int prec, int conv,
+        long double value);
+    void formatBody(int flags, int width, const char *prefix,
+        size_t prefixLen, size_t zeros, const char *body, size_t bodyLen);
+
+    char *buf;
+    size_t len;
+    size_t cap;
+};
+
+}  // namespace common
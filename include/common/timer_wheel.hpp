@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <platform/type.hpp>
+
+/**
+ * @file timer_wheel.hpp
+ * @brief Hierarchical timing wheel.
+*/
+
+namespace common {
+
+class TimerWheel;
+
+/**
+ * @brief A timer in the timer wheel.
+ * @details The timer is embedded in the object of the user,
+ * no memory is allocated when it's added to the timer wheel.
+*/
+class Timer {
+ public:
+    /// A callback function of the timer.
+    typedef void (*cb_t)(Timer *timer, void *arg);
+
+    Timer(): wheel(nullptr), prev(this), next(this),
+        expires(0), cb(nullptr), arg(nullptr) {}
+
+    /**
+     * @brief The timer is deleted from the wheel if it's pending.
+    */
+    ~Timer();
+
+    /**
+     * @brief Whether the timer is added and not expired.
+    */
+    bool isPending() const {
+        return wheel != nullptr;
+    }
+
+    /**
+     * @brief Get the expiration time of the timer in milliseconds.
+    */
+    u64 getExpires() const {
+        return expires;
+    }
+
+ private:
+    friend class TimerWheel;
+    explicit Timer(Timer const &);  /// not need to implement
+    Timer &operator = (const Timer &);  /// not need to implement
+
+    TimerWheel *wheel;
+    Timer *prev;
+    Timer *next;
+    u64 expires;
+    cb_t cb;
+    void *arg;
+};
+
+/**
+ * @brief A hierarchical timing wheel with the resolution of 1ms.
+ * @details Adding and deleting a timer are O(1), timers far in the future
+ * are cascaded into the lower level when their slot is reached.
+ * A timer can expire at most 2^32 ms (about 49 days) later.
+ * The timer wheel is not thread-safe.
+*/
+class TimerWheel {
+ public:
+    /**
+     * @param now is the current time in milliseconds.
+    */
+    explicit TimerWheel(u64 now);
+    ~TimerWheel();
+
+    /**
+     * @brief Add a timer to the wheel.
+     * @note The timer is restarted if it's pending.
+     *
+     * @param timer is a point to the timer.
+     * @param expires is the expiration time in milliseconds.
+     * @param cb is the callback of the timer.
+     * @param arg is a argument to pass to the callback function.
+    */
+    void add(Timer *timer, u64 expires, Timer::cb_t cb, void *arg);
+
+    /**
+     * @brief Delete a timer from the wheel if it's pending.
+     *
+     * @param timer is a point to the timer.
+    */
+    void del(Timer *timer);
+
+    /**
+     * @brief Call the callbacks of the expired timers.
+     * @details If a callback throws, the expired timers not run yet are
+     * kept in the wheel and run in the next run().
+     *
+     * @param now is the current time in milliseconds.
+    */
+    void run(u64 now);
+
+    /**
+     * @brief Get the time to wait for the next run().
+     * @details The result is never later than the earliest expiration,
+     * it may be earlier when the next timer is in a higher level.
+     *
+     * @param now is the current time in milliseconds.
+     * @return the time in milliseconds, -1 if there is no pending timer.
+    */
+    int getTimeout(u64 now) const;
+
+    /**
+     * @brief Get the number of the pending timers.
+    */
+    size_t size() const {
+        return count;
+    }
+
+ private:
+    explicit TimerWheel(TimerWheel const &);  /// not need to implement
+    TimerWheel &operator = (const TimerWheel &);  /// not need to implement
+
+    void enqueue(Timer *timer);
+    u32 cascade(int level);
+
+    u64 current;        ///< the time of the next slot to run
+    size_t count;       ///< the number of the pending timers
+    Timer *slots;       ///< the slot lists of all levels
+};
+
+}  // namespace common
@@ -0,0 +1,402 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+/**
+ * @file co.hpp
+ * @brief Coroutine awaitables on top of the poll, C++20 is required.
+ * @details The header is empty without coroutine support,
+ * so the callback interfaces of the poll still work with C++11.
+ *
+ * @code
+ * co::Task echo(Poll *poll, Handle *handle) {
+ *     char buf[256];
+ *     for (;;) {
+ *         size_t len = co_await co::read(poll, handle, buf, sizeof(buf));
+ *         if (len == 0) {
+ *             break;
+ *         }
+ *         co_await co::write(poll, handle, buf, len);
+ *     }
+ * }
+ * @endcode
+*/
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <common/log.hpp>
+#include <common/timer_wheel.hpp>
+#include <platform/handle.hpp>
+#include <platform/poll.hpp>
+
+/// The number of size classes of coroutine frames in the pool.
+#define PFM_CO_FRAME_CLASS_NUM 4
+/// The size of the smallest class of coroutine frames.
+#define PFM_CO_FRAME_MIN_SIZE 256
+/// The max number of free frames kept in a size class.
+#define PFM_CO_FRAME_FREE_MAX 64
+
+namespace platform {
+namespace co {
+
+/**
+ * @brief A pool recycling the coroutine frames.
+ * @details The free frames are kept per thread in size classes,
+ * the frames larger than the largest class are not pooled.
+*/
+class FramePool {
+ public:
+    static void *alloc(size_t size) {
+        int idx = getClass(size);
+        if (idx >= 0) {
+            FreeList *list = getFreeList(idx);
+            if (list->head) {
+                Frame *frame = list->head;
+                list->head = frame->next;
+                list->num--;
+                return frame;
+            }
+            size = PFM_CO_FRAME_MIN_SIZE << idx;
+        }
+        return ::operator new(size);
+    }
+
+    static void free(void *ptr, size_t size) {
+        int idx = getClass(size);
+        if (idx >= 0) {
+            FreeList *list = getFreeList(idx);
+            if (list->num < PFM_CO_FRAME_FREE_MAX) {
+                Frame *frame = static_cast<Frame *>(ptr);
+                frame->next = list->head;
+                list->head = frame;
+                list->num++;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+ private:
+    struct Frame {
+        Frame *next;
+    };
+
+    struct FreeList {
+        Frame *head;
+        size_t num;
+
+        ~FreeList() {
+            while (head) {
+                Frame *frame = head;
+                head = frame->next;
+                ::operator delete(frame);
+            }
+        }
+    };
+
+    /**
+     * @brief Get the size class of the frame, -1 if it's not pooled.
+    */
+    static int getClass(size_t size) {
+        for (int i = 0; i < PFM_CO_FRAME_CLASS_NUM; i++) {
+            if (size <= (static_cast<size_t>(PFM_CO_FRAME_MIN_SIZE) << i)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static FreeList *getFreeList(int idx) {
+        static thread_local FreeList lists[PFM_CO_FRAME_CLASS_NUM];
+        return lists + idx;
+    }
+};
+
+/**
+ * @brief A detached coroutine.
+ * @details It starts at once and its frame is freed when it returns.
+ * A common::Exception escaping from the coroutine is logged and ends it,
+ * other exceptions terminate the program.
+*/
+class Task {
+ public:
+    class promise_type {
+     public:
+        Task get_return_object() noexcept {
+            return Task();
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            try {
+                throw;
+            } catch (common::Exception &e) {
+                log_err("coroutine: %s", e.what());
+            } catch (...) {
+                std::terminate();
+            }
+        }
+
+        static void *operator new(size_t size) {
+            return FramePool::alloc(size);
+        }
+
+        static void operator delete(void *ptr, size_t size) {
+            FramePool::free(ptr, size);
+        }
+    };
+};
+
+/**
+ * @brief Awaiter of a handle event.
+ * @details The handle event is added to the poll when the coroutine
+ * suspends, and deleted before the coroutine resumes. The event must not
+ * be added to the poll by others.
+ * A subclass doing I/O overrides complete(), the coroutine is resumed
+ * once the I/O doesn't fail with ERR_AGAIN.
+*/
+class EventAwaiter {
+ public:
+    EventAwaiter(Poll *poll, Handle *handle, Poll::Event event):
+        poll(poll), handle(handle), event(event), failed(false) {}
+
+    virtual ~EventAwaiter() {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> coro) {
+        this->coro = coro;
+        poll->add(handle, event, onEvent, this);
+    }
+
+    void await_resume() const {
+        if (failed) {
+            throw PollException(poll, common::ERR_ERR,
+                "failed to add the handle to the poll");
+        }
+    }
+
+ protected:
+    /**
+     * @brief Do the I/O when the event is reported.
+     *
+     * @return false to wait for the event again.
+    */
+    virtual bool complete() {
+        return true;
+    }
+
+    Poll *poll;
+    Handle *handle;
+
+ private:
+    static void onEvent(Poll::Event event, Handle *handle, void *arg) {
+        EventAwaiter *awaiter = static_cast<EventAwaiter *>(arg);
+        // EV_ERR is the error of a add() from another thread, or of the
+        // deferred change, whose callback is still in the poll then.
+        if (event != awaiter->event) {
+            awaiter->failed = true;
+            try {
+                awaiter->poll->del(handle, awaiter->event);
+            } catch (const PollException &) {
+            }
+        } else if (!awaiter->complete()) {
+            return;
+        } else {
+            awaiter->poll->del(handle, event);
+        }
+        awaiter->coro.resume();
+    }
+
+    Poll::Event event;
+    bool failed;
+    std::coroutine_handle<> coro;
+};
+
+/**
+ * @brief Awaiter reading the handle.
+ * @details It reads at once, and waits for the handle to be readable
+ * only if no data is ready. The handle must be non-blocking.
+*/
+class ReadAwaiter: public EventAwaiter {
+ public:
+    ReadAwaiter(Poll *poll, Handle *handle, void *buf, size_t len):
+        EventAwaiter(poll, handle, Poll::EV_READ), buf(buf), len(len) {}
+
+    bool await_ready() {
+        return complete();
+    }
+
+    /**
+     * @return the number of bytes read, 0 at the end of file.
+    */
+    size_t await_resume() const {
+        EventAwaiter::await_resume();
+        if (result.err != common::ERR_OK) {
+            throw HandleException(handle, result.err,
+                "failed to read the handle");
+        }
+        return result.len;
+    }
+
+ protected:
+    bool complete() override {
+        do {
+            result = handle->tryRead(buf, len);
+        } while (result.err == common::ERR_INTR);
+        return result.err != common::ERR_AGAIN;
+    }
+
+ private:
+    void *buf;
+    size_t len;
+    IoResult result;
+};
+
+/**
+ * @brief Awaiter writing the handle.
+ * @details It writes at once, and waits for the handle to be writable
+ * only if it's full. The handle must be non-blocking.
+*/
+class WriteAwaiter: public EventAwaiter {
+ public:
+    WriteAwaiter(Poll *poll, Handle *handle, const void *buf, size_t len):
+        EventAwaiter(poll, handle, Poll::EV_WRITE), buf(buf), len(len) {}
+
+    bool await_ready() {
+        return complete();
+    }
+
+    /**
+     * @return the number of bytes written.
+    */
+    size_t await_resume() const {
+        EventAwaiter::await_resume();
+        if (result.err != common::ERR_OK) {
+            throw HandleException(handle, result.err,
+                "failed to write the handle");
+        }
+        return result.len;
+    }
+
+ protected:
+    bool complete() override {
+        do {
+            result = handle->tryWrite(buf, len);
+        } while (result.err == common::ERR_INTR);
+        return result.err != common::ERR_AGAIN;
+    }
+
+ private:
+    const void *buf;
+    size_t len;
+    IoResult result;
+};
+
+/**
+ * @brief Awaiter of a timer in the poll.
+*/
+class SleepAwaiter {
+ public:
+    SleepAwaiter(Poll *poll, u32 ms): poll(poll), ms(ms) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> coro) {
+        poll->addTimer(&timer, ms, onTimeout, coro.address());
+    }
+
+    void await_resume() const noexcept {}
+
+ private:
+    static void onTimeout(common::Timer *timer, void *arg) {
+        std::coroutine_handle<>::from_address(arg).resume();
+    }
+
+    Poll *poll;
+    u32 ms;
+    common::Timer timer;
+};
+
+/**
+ * @brief Wait until the handle is readable.
+ * @note It can be awaited in any thread, see Poll::add().
+*/
+inline EventAwaiter readable(Poll *poll, Handle *handle) {
+    return EventAwaiter(poll, handle, Poll::EV_READ);
+}
+
+/**
+ * @brief Wait until the handle is writable.
+ * @note It can be awaited in any thread, see Poll::add().
+*/
+inline EventAwaiter writable(Poll *poll, Handle *handle) {
+    return EventAwaiter(poll, handle, Poll::EV_WRITE);
+}
+
+/**
+ * @brief Read the handle, wait until it's readable if no data is ready.
+ *
+ * @return the number of bytes read, 0 at the end of file.
+*/
+inline ReadAwaiter read(Poll *poll, Handle *handle, void *buf, size_t len) {
+    return ReadAwaiter(poll, handle, buf, len);
+}
+
+/**
+ * @brief Write the handle, wait until it's writable if it's full.
+ *
+ * @return the number of bytes written.
+*/
+inline WriteAwaiter write(Poll *poll, Handle *handle,
+    const void *buf, size_t len) {
+    return WriteAwaiter(poll, handle, buf, len);
+}
+
+/**
+ * @brief Sleep for milliseconds.
+ * @note It must be awaited in the thread doing polling(), see Poll::addTimer().
+*/
+inline SleepAwaiter sleep(Poll *poll, u32 ms) {
+    return SleepAwaiter(poll, ms);
+}
+
+}  // namespace co
+}  // namespace platform
+
+#endif  // __cpp_impl_coroutine
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <common/exception.hpp>
+#include <platform/handle.hpp>
+#include <platform/poll.hpp>
+
+/**
+ * @file file_io.hpp
+ * @brief Platform asynchronous file I/O interfaces
+*/
+
+namespace platform {
+
+#ifdef PFM_SUPPORT_FILE_HANDLE
+/// Only used by class FileIo, need a platform to implement.
+class FileIoPriv;
+
+/**
+ * @brief Asynchronous positional file I/O.
+ * @details The I/O is done by a pool of worker threads, the callback is
+ * posted to a poll when the I/O is finished, so it runs in the thread
+ * doing the polling() and the disk I/O never blocks the poll.
+ * The FileIo doesn't own the polls, it must be destroyed before
+ * the polls passed to read() and write(). The destructor finishes
+ * the pending I/O and still posts the callbacks.
+*/
+class FileIo {
+ public:
+    /**
+     * @brief The callback of a finished I/O.
+     *
+     * @param err is ERR_OK if the I/O is finished, or the error
+     * @param len is the number of bytes transferred, less than requested
+     * only if the end of the file is reached or an error occurs
+     * @param arg is the argument passed to read() or write()
+    */
+    typedef void (*cb_t)(common::ErrorCode err, size_t len, void *arg);
+
+    /**
+     * @brief Start the worker threads.
+     *
+     * @param num is the number of worker threads
+    */
+    explicit FileIo(u32 num = 4);
+
+    /**
+     * @brief Finish the pending I/O and stop the worker threads.
+    */
+    ~FileIo();
+
+    /**
+     * @brief Read a file asynchronously.
+     * @details The file and the buffer must be valid until the callback.
+     *
+     * @param poll is the poll to run the callback
+     * @param file is the file to read
+     * @param buf is the buffer to store the data
+     * @param len is the number of bytes to read
+     * @param offset is the offset of the file
+     * @param cb is the callback
+     * @param arg is a argument to pass to the callback function
+    */
+    void read(Poll *poll, FileHandle *file, void *buf, size_t len,
+        u64 offset, cb_t cb, void *arg);
+
+    /**
+     * @brief Write a file asynchronously.
+     * @details The file and the data must be valid until the callback.
+     *
+     * @param poll is the poll to run the callback
+     * @param file is the file to write
+     * @param buf is the data to write
+     * @param len is the number of bytes to write
+     * @param offset is the offset of the file
+     * @param cb is the callback
+     * @param arg is a argument to pass to the callback function
+    */
+    void write(Poll *poll, FileHandle *file, const void *buf, size_t len,
+        u64 offset, cb_t cb, void *arg);
+
+    /**
+     * @brief Get the number of worker threads.
+    */
+    u32 getSize() const;
+
+ private:
+    explicit FileIo(FileIo const &);  /// not need to implement
+    FileIo &operator = (const FileIo &);  /// not need to implement
+    FileIoPriv *priv;
+};
+
+typedef common::ObjectException<FileIo> FileIoException;
+#endif  // PFM_SUPPORT_FILE_HANDLE
+
+}  // namespace platform
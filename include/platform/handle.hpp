@@ -37,6 +37,30 @@ namespace platform {
 /// Only used by class Handle, need a platform to implement.
 class HandlePriv;
 
+/**
+ * @brief A buffer span of the vectored I/O, the same layout as
+ * the system I/O vector.
+*/
+struct IoVec {
+    void *base;     ///< start of the buffer
+    size_t len;     ///< length of the buffer
+};
+
+/**
+ * @brief The result of a read or write which doesn't throw.
+*/
+struct IoResult {
+    size_t len;             ///< the number of bytes transferred
+    common::ErrorCode err;  ///< ERR_OK if transferred, or the error
+
+    /**
+     * @brief Whether a read reached the end of file.
+    */
+    bool isEof() const {
+        return len == 0 && err == common::ERR_OK;
+    }
+};
+
 class Handle {
  public:
     static Handle *in();
@@ -48,11 +72,93 @@ class Handle {
     size_t write(const void *buf, size_t len);
     size_t read(void *buf, size_t len);
 
+    /**
+     * @brief Write data without throwing, for the hot paths of
+     * the non-blocking handles.
+     *
+     * @param buf is the data to write
+     * @param len is the length of the data
+     * @return the number of bytes written, or the error, ERR_AGAIN if
+     * the handle is not ready.
+    */
+    IoResult tryWrite(const void *buf, size_t len);
+
+    /**
+     * @brief Read data without throwing, for the hot paths of
+     * the non-blocking handles.
+     *
+     * @param buf is the buffer to store the data
+     * @param len is the length of the buffer
+     * @return the number of bytes read, or the error, ERR_AGAIN if
+     * no data is ready. IoResult::isEof() is true at the end of file.
+    */
+    IoResult tryRead(void *buf, size_t len);
+
+    /**
+     * @brief The same as writev(), but doesn't throw.
+    */
+    IoResult tryWritev(const IoVec *iov, size_t cnt);
+
+    /**
+     * @brief The same as readv(), but doesn't throw.
+    */
+    IoResult tryReadv(const IoVec *iov, size_t cnt);
+
+    /**
+     * @brief Write the buffers in one system call.
+     *
+     * @param iov is the array of buffers
+     * @param cnt is the number of buffers
+     * @return the number of bytes written, may be less than the total.
+    */
+    size_t writev(const IoVec *iov, size_t cnt);
+
+    /**
+     * @brief Read data into the buffers in one system call.
+     *
+     * @param iov is the array of buffers
+     * @param cnt is the number of buffers
+     * @return the number of bytes read.
+    */
+    size_t readv(const IoVec *iov, size_t cnt);
+
+    /**
+     * @brief Write all the buffers, the partial writes are continued.
+     * @details The buffers are advanced as they are written, if an error
+     * is thrown, iov holds the data not written.
+     *
+     * @param iov is the array of buffers
+     * @param cnt is the number of buffers
+    */
+    void writevAll(IoVec *iov, size_t cnt);
+
+    /**
+     * @brief Transfer data to another handle in the kernel.
+     * @details The data is not copied through the user space, the way
+     * depends on the types of the handles: copy_file_range for a file to
+     * a file, sendfile for a file to others, splice for the others.
+     *
+     * If a handle is not ready, HandleException with ERR_AGAIN is thrown,
+     * the object of the exception is the handle to wait, for EV_READ if
+     * it's this handle, for EV_WRITE if it's dst. The data read from
+     * a socket or a pipe but not written yet is kept in the handle, the
+     * next call with the same dst writes it first.
+     *
+     * @param dst is the destination handle
+     * @param offset is the offset to read from a file and it's advanced,
+     * if it's nullptr, the current position of the file is used.
+     * Must be nullptr if this handle is not a file.
+     * @param len is the maximum number of bytes to transfer
+     * @return the number of bytes written to dst, 0 at the end of the data.
+    */
+    size_t transferTo(Handle *dst, u64 *offset, size_t len);
+
     void print(const char *fmt, ...) ARGS_FORMAT(2, 3);
     void vprint(const char *fmt, va_list args);
 
  protected:
     friend class Poll;
+    friend class FileIo;
     HandlePriv *priv;
     Handle();
 };
@@ -78,10 +184,37 @@ class FileHandle: public Handle {
 
     explicit FileHandle(const char *path, int flag);
     size_t seek(SeekMode mode, ssize_t len);
+
+    /**
+     * @brief Read data at an offset, the file position is not changed.
+     * @details It's safe to be called from many threads.
+     *
+     * @param buf is the buffer to store the data
+     * @param len is the length of the buffer
+     * @param offset is the offset of the file
+     * @return the number of bytes read.
+    */
+    size_t pread(void *buf, size_t len, u64 offset);
+
+    /**
+     * @brief Write data at an offset, the file position is not changed.
+     * @details It's safe to be called from many threads.
+     *
+     * @param buf is the data to write
+     * @param len is the length of the data
+     * @param offset is the offset of the file
+     * @return the number of bytes written.
+    */
+    size_t pwrite(const void *buf, size_t len, u64 offset);
 };
 #endif  // PFM_SUPPORT_FILE_HANDLE
 
 #ifdef PFM_SUPPORT_SOCKET_HANDLE
+/**
+ * @brief A non-blocking socket.
+ * @details The socket is created with non-blocking and close-on-exec,
+ * use Poll to wait for it to be ready.
+*/
 class SocketHandle: public Handle {
  public:
     enum DomainType {
@@ -96,13 +229,177 @@ class SocketHandle: public Handle {
         S_RAM,
     };
 
+    /**
+     * @enum Socket options.
+    */
+    enum Option {
+        O_REUSE_ADDR,       ///< allow to bind an address in TIME_WAIT
+        O_REUSE_PORT,       ///< allow many sockets to bind the same port
+        O_NO_DELAY,         ///< disable the Nagle algorithm of TCP
+        O_KEEP_ALIVE,       ///< send keep-alive probes
+        O_SEND_BUF,         ///< the size of the send buffer
+        O_RECV_BUF,         ///< the size of the receive buffer
+        O_UDP_SEGMENT,      ///< the segment size of UDP GSO, 0 to disable
+        O_UDP_GRO,          ///< receive the coalesced UDP datagrams
+    };
+
+    /// The id of a send which is copied, no completion is reported.
+    static const u32 ZC_COPIED = ~0U;
+
+    /**
+     * @brief A datagram of the batched UDP I/O.
+    */
+    struct Datagram {
+        void *buf;          ///< the buffer of the data
+        size_t len;         ///< the length of the data
+        u32 ip;             ///< the IPv4 address of the peer
+        u16 port;           ///< the port of the peer, 0 if connected
+        /**
+         * The size of the segments in the buffer. When sending, the buffer
+         * is split into the datagrams of this size by the system (GSO).
+         * When received with O_UDP_GRO, the buffer holds the datagrams
+         * of this size coalesced by the system (GRO). 0 if not.
+        */
+        u16 segSize;
+    };
+
     explicit SocketHandle(DomainType domain, SockType sock);
 
+    /**
+     * @brief Bind the socket to an address.
+     *
+     * @param addr is the address, nullptr means any address
+     * @param port is the port, 0 means a port selected by the system
+    */
     void bind(const platform::net::Addr *addr, u16 port);
 
-    void accept(const platform::net::Addr *addr, u16 port);
+    /**
+     * @brief Listen for connections.
+     *
+     * @param backlog is the maximum length of the pending connections
+    */
+    void listen(int backlog = 128);
+
+    /**
+     * @brief Accept a connection.
+     *
+     * @param addr is the buffer to retrieve the peer address, it can be NULL
+     * @param port is the buffer to retrieve the peer port, it can be NULL
+     * @return the socket of the connection, nullptr if no connection
+     * is pending.
+    */
+    SocketHandle *accept(platform::net::Addr4 *addr = nullptr,
+        u16 *port = nullptr);
+
+    /**
+     * @brief Accept all the pending connections, up to num.
+     * @details Call it in the EV_READ callback of the listening socket
+     * until it returns less than num, to drain the pending connections.
+     *
+     * @param handles is the array to retrieve the sockets
+     * @param num is the length of the array
+     * @return the number of the accepted sockets.
+    */
+    size_t accept(SocketHandle **handles, size_t num);
+
+    /**
+     * @brief Connect to an address.
+     * @details If the connection can't be completed immediately, wait for
+     * EV_WRITE of the socket and call finishConnect().
+     *
+     * @param addr is the address
+     * @param port is the port
+     * @return true if the connection is completed, false if in progress.
+    */
+    bool connect(const platform::net::Addr *addr, u16 port);
+
+    /**
+     * @brief Check the result of a connection in progress,
+     * throw HandleException if it failed.
+    */
+    void finishConnect();
+
+    /**
+     * @brief Set an option of the socket.
+     *
+     * @param opt is the option
+     * @param value is the value, 0 or 1 for the boolean options
+    */
+    void setOption(Option opt, int value);
+
+    /**
+     * @brief Get an option of the socket.
+    */
+    int getOption(Option opt);
+
+    /**
+     * @brief Get the port the socket is bound to.
+    */
+    u16 getLocalPort();
+
+    /**
+     * @brief Receive the datagrams in one system call.
+     * @details For each datagram, len is the length of buf, it's set to
+     * the length received, and the peer is set.
+     *
+     * @param msgs is the array of datagrams
+     * @param num is the length of the array, up to 64 in one call
+     * @return the number of the datagrams received, 0 if none is pending.
+    */
+    size_t recvBatch(Datagram *msgs, size_t num);
+
+    /**
+     * @brief Send the datagrams in one system call.
+     *
+     * @param msgs is the array of datagrams, the port is 0 to send
+     * to the connected peer
+     * @param num is the length of the array, up to 64 in one call
+     * @return the number of the datagrams sent, 0 if the socket
+     * is not writable.
+    */
+    size_t sendBatch(const Datagram *msgs, size_t num);
+
+    /**
+     * @brief Enable the zero-copy send of the socket.
+     * @details The buffers sent by sendZeroCopy() are not copied to the
+     * system, they are pinned until the completions are reported.
+     * The completions are reported by EV_ERR of the socket, add an EV_ERR
+     * callback to the poll and call readZeroCopy() in it.
+     *
+     * @param threshold is the minimum size to send without copy,
+     * the smaller sends are copied, 0 disables the zero-copy send
+    */
+    void setZeroCopy(size_t threshold);
+
+    /**
+     * @brief Send data, without copy if it's not smaller than the threshold.
+     *
+     * @param buf is the data, must not be changed until the completion
+     * of the id
+     * @param len is the length of the data
+     * @param id is the buffer to retrieve the id of the send,
+     * ZC_COPIED if the data is copied and the buffer can be reused at once
+     * @return the number of bytes sent.
+    */
+    size_t sendZeroCopy(const void *buf, size_t len, u32 *id);
+
+    /**
+     * @brief Read a completion of the zero-copy sends.
+     * @details A completion reports that the sends with the ids in
+     * [first, last] are finished, their buffers can be reused.
+     *
+     * @param first is the buffer to retrieve the first id
+     * @param last is the buffer to retrieve the last id
+     * @param copied is the buffer to retrieve whether the system copied
+     * the data anyway, then the zero-copy send doesn't help, it can be NULL
+     * @return false if no completion is pending.
+     * @note If the sends failed, HandleException is thrown after first
+     * and last are set, their buffers can be reused too.
+    */
+    bool readZeroCopy(u32 *first, u32 *last, bool *copied);
 
-    void connect(const platform::net::Addr *addr, u16 port);
+ private:
+    SocketHandle() {}
 };
 #endif  // PFM_SUPPORT_SOCKET_HANDLE
 
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <common/exception.hpp>
+#include <platform/type.hpp>
+#include <platform/config.hpp>
+
+/**
+ * @file mapped_file.hpp
+ * @brief Platform memory-mapped file interfaces
+*/
+
+namespace platform {
+
+#ifdef PFM_SUPPORT_MAPPED_FILE
+/// Only used by class MappedFile, need a platform to implement.
+class MappedFilePriv;
+
+/**
+ * @brief A read-only file mapped into the memory.
+ * @details The pages are loaded on demand from the page cache,
+ * and shared by all the processes mapping the same file.
+*/
+class MappedFile {
+ public:
+    enum Flag {
+        F_POPULATE = (1 << 0),  ///< load all the pages when mapping
+        F_HUGEPAGE = (1 << 1),  ///< use huge pages if the system supports
+    };
+
+    /**
+     * @enum The access pattern hints.
+    */
+    enum Advice {
+        A_NORMAL,
+        A_SEQUENTIAL,       ///< read ahead aggressively
+        A_RANDOM,           ///< don't read ahead
+        A_WILLNEED,         ///< load the pages in the background
+        A_DONTNEED,         ///< the pages can be dropped
+    };
+
+    /**
+     * @brief Map a file.
+     *
+     * @param path is the path of the file
+     * @param flags is the bitmask of MappedFile::Flag
+    */
+    explicit MappedFile(const char *path, int flags = 0);
+
+    ~MappedFile();
+
+    /**
+     * @brief Get the start of the mapped data, nullptr if the file is empty.
+    */
+    const void *getData() const;
+
+    /**
+     * @brief Get the size of the mapped data.
+    */
+    size_t getSize() const;
+
+    /**
+     * @brief Get a range of the mapped data.
+     *
+     * @param offset is the offset of the range
+     * @param len is the length of the range
+     * @return the start of the range.
+    */
+    const void *getRange(size_t offset, size_t len) const;
+
+    /**
+     * @brief Give a hint of the access pattern.
+     *
+     * @param advice is the access pattern
+     * @param offset is the offset of the range
+     * @param len is the length of the range, 0 means to the end
+    */
+    void advise(Advice advice, size_t offset = 0, size_t len = 0);
+
+    /**
+     * @brief Map the file again if its size changed.
+     * @details The pointers got before are invalid if the file is remapped.
+     * The hint given for the whole file is applied again.
+     *
+     * @return true if the file is remapped.
+    */
+    bool remap();
+
+ private:
+    explicit MappedFile(MappedFile const &);  /// not need to implement
+    MappedFile &operator = (const MappedFile &);  /// not need to implement
+    MappedFilePriv *priv;
+};
+
+typedef common::ObjectException<MappedFile> MappedFileException;
+#endif  // PFM_SUPPORT_MAPPED_FILE
+
+}  // namespace platform
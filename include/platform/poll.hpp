@@ -21,7 +21,12 @@
 */
 #pragma once
 
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <common/exception.hpp>
+#include <common/timer_wheel.hpp>
 #include <platform/handle.hpp>
 #include <platform/lock.hpp>
 
@@ -46,25 +51,240 @@ class Poll {
         EV_ERR,       ///< error event
     };
 
+    /**
+     * @enum Flags of the handle in the poll.
+    */
+    enum Flag {
+        F_EDGE = (1 << 0),      ///< edge-triggered, drain until ERR_AGAIN
+        F_ONESHOT = (1 << 1),   ///< disabled after reporting, see rearm()
+        F_RDHUP = (1 << 2),     ///< report EV_READ when the peer shuts down
+        /// wake up one of the polls sharing the handle, epoll backend only
+        F_EXCLUSIVE = (1 << 3),
+        F_BUSY_POLL = (1 << 4), ///< busy poll the socket, see setBusyPoll()
+        F_PRIO_HIGH = (1 << 5), ///< dispatched before the other handles
+        F_PRIO_LOW = (1 << 6),  ///< dispatched after the other handles
+        F_WAIT = (1 << 7),      ///< add() waits for the owner, see add()
+    };
+
+    /**
+     * @enum Backends of the poll.
+    */
+    enum Backend {
+        B_DEFAULT,      ///< the default backend of the platform
+        B_URING,        ///< io_uring, use the default if it's unavailable
+    };
+
+    /**
+     * @brief Statistics of the poll.
+    */
+    struct Stats {
+        u64 ctlCalls;       ///< control calls issued to the backend
+        u64 ctlSaved;       ///< control calls saved by the changelist
+        u64 spinWaits;      ///< non-blocking waits in the spin budget
+        u64 spinHits;       ///< spins returned with events
+        u64 blockWaits;     ///< blocking waits
+    };
+
     /// A callback function of the handle evnet.
     typedef void (*cb_t)(Poll::Event event, Handle *handle, void *arg);
 
-    Poll();
+    /// A task function posted to the poll.
+    typedef void (*task_t)(void *arg);
+
+    /// A callback function of the signal.
+    typedef void (*signal_cb_t)(int signo, void *arg);
+
+    /**
+     * @brief A callable of the handle event, called with
+     * (Poll::Event event, Handle *handle).
+     * @details The callable is stored inline if it's not larger than
+     * CALLBACK_SIZE bytes, otherwise it's allocated in the heap.
+    */
+    class Callback {
+     public:
+        /// The size of the inline buffer.
+        static const size_t CALLBACK_SIZE = 48;
+
+        Callback(): ops(nullptr) {}
+
+        Callback(cb_t cb, void *arg): ops(nullptr) {
+            set(FnCallback(cb, arg), std::true_type());
+        }
+
+        template <class F, class = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, Callback>::value>::type,
+            class = decltype(std::declval<typename std::decay<F>::type &>()(
+                std::declval<Event>(), std::declval<Handle *>()))>
+        Callback(F &&fn): ops(nullptr) {  // NOLINT(runtime/explicit)
+            typedef typename std::decay<F>::type Fn;
+            set(std::forward<F>(fn), std::integral_constant<bool,
+                sizeof(Fn) <= CALLBACK_SIZE &&
+                alignof(Fn) <= alignof(std::max_align_t) &&
+                std::is_nothrow_move_constructible<Fn>::value>());
+        }
+
+        Callback(Callback &&other): ops(other.ops) {
+            if (ops) {
+                ops->relocate(buf, other.buf);
+                other.ops = nullptr;
+            }
+        }
+
+        Callback &operator = (Callback &&other) {
+            if (this != &other) {
+                reset();
+                if (other.ops) {
+                    other.ops->relocate(buf, other.buf);
+                    ops = other.ops;
+                    other.ops = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        ~Callback() {
+            reset();
+        }
+
+        /**
+         * @brief Destroy the callable, the callback becomes empty.
+        */
+        void reset() {
+            if (ops) {
+                ops->destroy(buf);
+                ops = nullptr;
+            }
+        }
+
+        explicit operator bool() const {
+            return ops != nullptr;
+        }
+
+        void operator()(Event event, Handle *handle) {
+            ops->call(buf, event, handle);
+        }
+
+     private:
+        Callback(const Callback &) = delete;
+        Callback &operator = (const Callback &) = delete;
+
+        struct Ops {
+            void (*call)(void *buf, Event event, Handle *handle);
+            void (*relocate)(void *dst, void *src);
+            void (*destroy)(void *buf);
+        };
+
+        class FnCallback {
+         public:
+            FnCallback(cb_t cb, void *arg): cb(cb), arg(arg) {}
+
+            void operator()(Event event, Handle *handle) const {
+                cb(event, handle, arg);
+            }
+
+         private:
+            cb_t cb;
+            void *arg;
+        };
+
+        /// The operations of a callable stored inline.
+        template <class F>
+        class InlineOps {
+         public:
+            static void call(void *buf, Event event, Handle *handle) {
+                (*static_cast<F *>(buf))(event, handle);
+            }
+
+            static void relocate(void *dst, void *src) {
+                F *fn = static_cast<F *>(src);
+                new (dst) F(std::move(*fn));
+                fn->~F();
+            }
+
+            static void destroy(void *buf) {
+                static_cast<F *>(buf)->~F();
+            }
+
+            static const Ops ops;
+        };
+
+        /// The operations of a callable allocated in the heap.
+        template <class F>
+        class HeapOps {
+         public:
+            static void call(void *buf, Event event, Handle *handle) {
+                (**static_cast<F **>(buf))(event, handle);
+            }
+
+            static void relocate(void *dst, void *src) {
+                *static_cast<F **>(dst) = *static_cast<F **>(src);
+            }
+
+            static void destroy(void *buf) {
+                delete *static_cast<F **>(buf);
+            }
+
+            static const Ops ops;
+        };
+
+        template <class F>
+        void set(F &&fn, std::true_type) {
+            typedef typename std::decay<F>::type Fn;
+            new (buf) Fn(std::forward<F>(fn));
+            ops = &InlineOps<Fn>::ops;
+        }
+
+        template <class F>
+        void set(F &&fn, std::false_type) {
+            typedef typename std::decay<F>::type Fn;
+            *reinterpret_cast<Fn **>(buf) = new Fn(std::forward<F>(fn));
+            ops = &HeapOps<Fn>::ops;
+        }
+
+        const Ops *ops;
+        alignas(std::max_align_t) unsigned char buf[CALLBACK_SIZE];
+    };
+
+    explicit Poll(Backend backend = B_DEFAULT);
     ~Poll();
 
     /**
      * @brief Add handle event to the poll.
      * @note A handle can be added multiple events, but a handle event can be added only once.
+     * The flags apply to the handle, all events of a handle must be added
+     * with the same flags. The changes of an added handle are deferred and
+     * coalesced until the next polling(), an error of them is reported
+     * to the EV_ERR callback, or to the other callbacks of the handle with
+     * EV_ERR if it has no EV_ERR callback.
+     * It can be called from any thread. If another thread is doing polling(),
+     * the handle is added by that thread later, and an error is reported
+     * to the callback with EV_ERR instead of being thrown. With F_WAIT,
+     * it waits until that thread adds the handle and the error is thrown,
+     * it must not be called from a callback of another poll then.
      *
      * @param handle is a point to handle
      * @param event is the event of the handle
      * @param cb is the callback of the handle evnet
      * @param arg is a argument to pass to the callback function
+     * @param flags is the flags of the handle, see enum Flag
+    */
+    void add(Handle *handle, Event event, cb_t cb, void *arg, int flags = 0);
+
+    /**
+     * @brief Add handle event to the poll with a callable.
+     * @details Same as the add() above, a lambda with captures can be used
+     * as the callback, see class Callback.
+     *
+     * @param handle is a point to handle
+     * @param event is the event of the handle
+     * @param cb is the callable of the handle evnet
+     * @param flags is the flags of the handle, see enum Flag
     */
-    void add(Handle *handle, Event event, cb_t cb, void *arg);
+    void add(Handle *handle, Event event, Callback cb, int flags = 0);
 
     /**
      * @brief Modify already added handle events.
+     * @note It can be called from any thread, same as add().
      *
      * @param handle is a point to handle
      * @param event is the event of the handle
@@ -73,16 +293,135 @@ class Poll {
     */
     void mod(Handle *handle, Event event, cb_t cb, void *arg);
 
+    /**
+     * @brief Modify already added handle events with a callable.
+     *
+     * @param handle is a point to handle
+     * @param event is the event of the handle
+     * @param cb is the callable of the handle evnet
+    */
+    void mod(Handle *handle, Event event, Callback cb);
+
     /**
      * @brief Delete already added handle events.
+     * @note It can be called from any thread. If another thread is doing
+     * polling(), it waits for that thread to delete the handle event,
+     * the callback is not running and will not be called after it returns.
+     * So it must not be called with a poll waiting for the calling thread.
      *
      * @param handle is a point to handle
      * @param event is the event of the handle
     */
     void del(Handle *handle, Event event);
 
+    /**
+     * @brief Enable the events of a handle added with F_ONESHOT again.
+     * @note It can be called from any thread, same as add().
+     *
+     * @param handle is a point to handle
+    */
+    void rearm(Handle *handle);
+
+    /**
+     * @brief Handle a signal in polling().
+     * @details The signal is blocked in the calling thread and read from
+     * a signalfd, the callback is an ordinary function called in the thread
+     * doing polling(). Signals arriving together are handled in one batch,
+     * a signal pending more than once is reported once.
+     * @note The signal must be blocked in all threads, add it before
+     * creating the threads, they inherit the blocked signals.
+     * It must be called in the thread owning the poll, see add().
+     *
+     * @param signo is the signal number
+     * @param cb is the callback of the signal
+     * @param arg is a argument to pass to the callback function
+    */
+    void addSignal(int signo, signal_cb_t cb, void *arg);
+
+    /**
+     * @brief Stop handling a signal, the signal is still blocked.
+     *
+     * @param signo is the signal number
+    */
+    void delSignal(int signo);
+
+    /**
+     * @brief Enable the busy poll mode.
+     * @details polling() spins with non-blocking waits for the budget
+     * before it blocks, it trades CPU for the wakeup latency.
+     * The sockets added with F_BUSY_POLL are set SO_BUSY_POLL to the budget,
+     * so the spins also poll the device queue of the socket.
+     * The ratio of spinHits to blockWaits in getStats() helps to
+     * tune the budget.
+     * @note It must be called in the thread owning the poll, see add().
+     *
+     * @param us is the spin budget in microseconds, 0 to disable
+    */
+    void setBusyPoll(u32 us);
+
+    /**
+     * @brief Set the max number of EV_READ callbacks of a handle
+     * in a polling(), see setReady(). The default is 1.
+     *
+     * @param num is the number of callbacks, must be positive
+    */
+    void setReadBudget(u32 num);
+
+    /**
+     * @brief Mark the handle still readable.
+     * @details A EV_READ callback reading a part of the data calls it to let
+     * the other handles run, the callback is called again without a event
+     * from the backend. It's called again in the same polling() within
+     * the read budget, otherwise it's carried to the next polling(),
+     * which doesn't block then. The events in a polling() are dispatched
+     * from the handles added with F_PRIO_HIGH to the ones with F_PRIO_LOW.
+     * @note It must be called in the thread owning the poll, see add().
+     *
+     * @param handle is a point to handle
+    */
+    void setReady(Handle *handle);
+
+    /**
+     * @brief Get the backend in use, it may differ from the requested one.
+    */
+    Backend getBackend() const;
+
+    /**
+     * @brief Get the number of handles added to the poll.
+    */
+    u32 getSize() const;
+
+    /**
+     * @brief Get the statistics of the poll.
+     *
+     * @param stats is the buffer to store the statistics
+    */
+    void getStats(Stats *stats) const;
+
+    /**
+     * @brief Start a timer in the poll.
+     * @details The timer callback is called in polling() after the handle
+     * callbacks and the posted tasks. It must be called in the thread doing
+     * polling(), the timer is restarted if it's pending.
+     *
+     * @param timer is a point to the timer
+     * @param ms is the timeout in milliseconds
+     * @param cb is the callback of the timer
+     * @param arg is a argument to pass to the callback function
+    */
+    void addTimer(common::Timer *timer, u32 ms,
+        common::Timer::cb_t cb, void *arg);
+
+    /**
+     * @brief Stop a timer in the poll, nothing happens if it's not pending.
+     *
+     * @param timer is a point to the timer
+    */
+    void delTimer(common::Timer *timer);
+
     /**
      * @brief It blocks the thread for the max_wait ms, and do the platform polling.
+     * @details The wait time is shortened to the expiration of the next timer.
      * 
      * @param timeout specifies the maximum wait time in milliseconds(-1 == infinite)
     */
@@ -90,13 +429,36 @@ class Poll {
 
     /**
      * @brief Wakeup the polling().
+     * @details It can be called from any thread,
+     * wakeups before the polling() returns are coalesced into one.
     */
     void wakeup();
 
+    /**
+     * @brief Post a task to run in the thread doing polling().
+     * @details It can be called from any thread, the tasks run in posted order
+     * after the handle callbacks. Only the first post of a burst wakes up
+     * the polling().
+     *
+     * @param fn is the task function
+     * @param arg is a argument to pass to the task function
+    */
+    void post(task_t fn, void *arg);
+
  private:
     PollPriv *priv;
 };
 
+template <class F>
+const Poll::Callback::Ops Poll::Callback::InlineOps<F>::ops = {
+    &InlineOps<F>::call, &InlineOps<F>::relocate, &InlineOps<F>::destroy,
+};
+
+template <class F>
+const Poll::Callback::Ops Poll::Callback::HeapOps<F>::ops = {
+    &HeapOps<F>::call, &HeapOps<F>::relocate, &HeapOps<F>::destroy,
+};
+
 typedef common::ObjectException<Poll> PollException;
 
 }  // namespace platform
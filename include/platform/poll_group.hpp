@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <common/exception.hpp>
+#include <platform/handle.hpp>
+#include <platform/poll.hpp>
+
+/**
+ * @file poll_group.hpp
+ * @brief Platform poll group interfaces
+*/
+
+namespace platform {
+
+/// Only used by class PollGroup, need a platform to implement.
+class PollGroupPriv;
+
+/**
+ * @brief A group of polls, each poll runs polling() in its own thread.
+ * @details The callbacks should catch their exceptions, an exception
+ * escaping polling() is logged and stops the thread of the poll.
+*/
+class PollGroup {
+ public:
+    /**
+     * @enum Policies to select a poll for a new handle.
+    */
+    enum Policy {
+        P_ROUND_ROBIN,      ///< select the polls in turn
+        P_LEAST_LOADED,     ///< select the poll with the fewest handles
+        P_HASH,             ///< select the poll by the hash of the handle
+    };
+
+    /**
+     * @brief Create the polls, the threads are not started.
+     *
+     * @param num is the number of polls, 0 means the number of online CPUs
+     * @param policy is the policy to select a poll
+    */
+    explicit PollGroup(u32 num = 0, Policy policy = P_ROUND_ROBIN);
+
+    /**
+     * @brief Stop the threads and destroy the polls.
+    */
+    ~PollGroup();
+
+    /**
+     * @brief Start a thread for each poll, the thread N is pinned to CPU N.
+    */
+    void start();
+
+    /**
+     * @brief Stop the threads and wait for them to exit.
+    */
+    void stop();
+
+    /**
+     * @brief Get the number of polls.
+    */
+    u32 getSize() const;
+
+    /**
+     * @brief Get a poll of the group.
+     *
+     * @param index is the index of the poll, less than getSize()
+    */
+    Poll *getPoll(u32 index);
+
+    /**
+     * @brief Select a poll by the policy.
+     *
+     * @param handle is a point to handle
+     * @return the selected poll
+    */
+    Poll *select(Handle *handle);
+
+    /**
+     * @brief Select a poll by the policy and add the handle event to it.
+     *
+     * @param handle is a point to handle
+     * @param event is the event of the handle
+     * @param cb is the callback of the handle evnet
+     * @param arg is a argument to pass to the callback function
+     * @param flags is the flags of the handle, see enum Poll::Flag
+     * @return the poll which the handle is added to
+    */
+    Poll *add(Handle *handle, Poll::Event event,
+        Poll::cb_t cb, void *arg, int flags = 0);
+
+    /**
+     * @brief Add a shared handle event to all polls, e.g. a listening socket.
+     * @details It's added with Poll::F_EXCLUSIVE, only one of the polls
+     * is woken up for an event. It waits for the running polls to add it,
+     * if one of them fails, it's removed from the others and thrown.
+     *
+     * @param handle is a point to handle
+     * @param event is the event of the handle
+     * @param cb is the callback of the handle evnet
+     * @param arg is a argument to pass to the callback function
+    */
+    void addShared(Handle *handle, Poll::Event event, Poll::cb_t cb, void *arg);
+
+    /**
+     * @brief Delete a shared handle event from all polls.
+     *
+     * @param handle is a point to handle
+     * @param event is the event of the handle
+    */
+    void delShared(Handle *handle, Poll::Event event);
+
+ private:
+    explicit PollGroup(PollGroup const &);  /// not need to implement
+    PollGroup &operator = (const PollGroup &);  /// not need to implement
+    PollGroupPriv *priv;
+};
+
+typedef common::ObjectException<PollGroup> PollGroupException;
+
+}  // namespace platform
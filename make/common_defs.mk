@@ -78,6 +78,14 @@ SOURCES_LIBCOMMON := \
 	$(wildcard $(COMMON_DIR)/src/platform/$(PLATFORM)/*.cpp)\
 	$(NULL)
 
+#
+# Source files of the benchmarks, one binary per source file.
+# Each one has its own app_main(), they are not added to $(SOURCES).
+#
+SOURCES_BENCH := \
+	$(wildcard $(COMMON_DIR)/bench/*.cpp)\
+	$(NULL)
+
 #
 # Source files of all
 #
@@ -92,12 +100,31 @@ LIBCOMMON_NAME = libcommon
 LIBCOMMON_DYNAMIC = $(LIB_DIR)/$(LIBCOMMON_NAME).so
 LIBCOMMON_STATIC = $(LIB_DIR)/$(LIBCOMMON_NAME).a
 
+#
+# Defines of the benchmarks
+#
+BENCH_DIR ?= $(BUILD_DIR)/bench
+BENCH_TARGETS = $(foreach src, $(SOURCES_BENCH),\
+	$(BENCH_DIR)/$(basename $(notdir $(src))))
+
+#
+# C++ standard, c++20 is required by the coroutines in platform/co.hpp
+#
+CXX_STD ?= c++11
+
+#
+# Source files of the benchmarks built with c++20, for platform/co.hpp
+#
+SOURCES_BENCH_CXX20 := \
+	$(COMMON_DIR)/bench/co_bench.cpp\
+	$(NULL)
+
 #
 # Compile command line switch of CPP
 #
-CPPFLAGS += -fPIC -ffunction-sections -fdata-sections -std=c++11
+CPPFLAGS += -fPIC -ffunction-sections -fdata-sections -std=$(CXX_STD)
 
 #
 # Compile command line switch of LD
 #
-LDFLAGS += -fPIC -Wl,--gc-sections
+LDFLAGS += -fPIC -Wl,--gc-sections -lpthread
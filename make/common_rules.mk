@@ -34,7 +34,7 @@ BUILD_CPPSTYLE_DIR ?= $(BUILD_DIR)/cppstyle
 CPPSTYLE ?= cpplint --quiet
 CPPSTYLE_INCLUDES := $(filter-out include, $(foreach dir, $(INCLUDES), $(shell find $(dir) -maxdepth 2 -type d)))
 CPPSTYLE_HEADERS := $(foreach dir, $(CPPSTYLE_INCLUDES), $(wildcard $(dir)/*.hpp))
-CPPSTYLE_SOURCES := $(SOURCES)
+CPPSTYLE_SOURCES := $(SOURCES) $(SOURCES_BENCH)
 CPPSTYLE_FILES := $(CPPSTYLE_HEADERS) $(CPPSTYLE_SOURCES)
 CPPSTYLE_TARGETS := $(CPPSTYLE_FILES:%=$(BUILD_CPPSTYLE_DIR)/%.cs)
 
@@ -71,6 +71,28 @@ $(eval $(call BUILD_TARGET_RULES, $(LIBCOMMON_DYNAMIC), METHOD_LD,\
 $(eval $(call BUILD_TARGET_RULES, $(LIBCOMMON_STATIC), METHOD_AR,\
 	$(SOURCES_LIBCOMMON)))
 
+#
+# Rules to build the benchmarks
+#
+$(foreach src, $(SOURCES_BENCH), $(eval $(call BUILD_TARGET_RULES,\
+	$(BENCH_DIR)/$(basename $(notdir $(src))), METHOD_LD, $(src),\
+	$(LIBCOMMON_STATIC))))
+
+$(BENCH_TARGETS): $(LIBCOMMON_STATIC)
+
+#
+# The later -std switch overrides $(CXX_STD)
+#
+$(SOURCES_BENCH_CXX20:%.cpp=$(BUILD_DIR)/%.o)\
+$(SOURCES_BENCH_CXX20:%.cpp=$(BUILD_DIR)/%.d): CPPFLAGS += -std=c++20
+
+#
+# Build and run the benchmarks, each prints the results as JSON in one line
+#
+.PHONY: bench
+bench: $(BENCH_TARGETS)
+	$(QUIET)for target in $^; do $$target || exit 1; done
+
 #
 # Rule to compile source code
 #
@@ -0,0 +1,367 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <common/assert.hpp>
+#include <common/buffer_chain.hpp>
+
+/// The maximum number of I/O vectors written at once.
+#define BUFFER_CHAIN_IOV_MAX 64
+
+namespace common {
+
+/**
+ * @brief A reference-counted block, the data follows the header.
+*/
+class BufferBlock {
+ public:
+    static BufferBlock *create(size_t size) {
+        void *mem = ::operator new(sizeof(BufferBlock) + size);
+        return new (mem) BufferBlock(size);
+    }
+
+    void ref() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void unref() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~BufferBlock();
+            ::operator delete(this);
+        }
+    }
+
+    /**
+     * @brief Whether the block is referenced only by one segment,
+     * then the room around the segment is free.
+    */
+    bool isUnique() const {
+        return refs.load(std::memory_order_acquire) == 1;
+    }
+
+    char *begin() {
+        return reinterpret_cast<char *>(this + 1);
+    }
+
+    char *end() {
+        return begin() + size;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+
+ private:
+    explicit BufferBlock(size_t size): refs(1), size(size) {}
+
+    std::atomic<u32> refs;
+    size_t size;
+};
+
+BufferChain::BufferChain(size_t blockSize): length(0),
+    blockSize(blockSize), spare(nullptr) {
+    ASSERT(blockSize);
+}
+
+BufferChain::~BufferChain() {
+    clear();
+    if (spare) {
+        spare->unref();
+    }
+}
+
+BufferBlock *BufferChain::newBlock(size_t size) {
+    if (spare && spare->getSize() >= size) {
+        BufferBlock *block = spare;
+        spare = nullptr;
+        return block;
+    }
+    return BufferBlock::create(size > blockSize ? size : blockSize);
+}
+
+void BufferChain::keepBlock(BufferBlock *block) {
+    if (spare) {
+        spare->unref();
+    }
+    spare = block;
+}
+
+char *BufferChain::getTailRoom(size_t *len) {
+    if (segs.empty()) {
+        return nullptr;
+    }
+    Segment &seg = segs.back();
+    char *tail = seg.data + seg.len;
+    if (!seg.block->isUnique() || tail == seg.block->end()) {
+        return nullptr;
+    }
+    *len = seg.block->end() - tail;
+    return tail;
+}
+
+void BufferChain::append(const void *buf, size_t len) {
+    const char *src = static_cast<const char *>(buf);
+    size_t room;
+
+    length += len;
+    char *tail = getTailRoom(&room);
+    if (tail) {
+        size_t n = len < room ? len : room;
+        memcpy(tail, src, n);
+        segs.back().len += n;
+        src += n;
+        len -= n;
+    }
+    if (len) {
+        Segment seg;
+        seg.block = newBlock(len);
+        seg.data = seg.block->begin();
+        seg.len = len;
+        memcpy(seg.data, src, len);
+        segs.push_back(seg);
+    }
+}
+
+void BufferChain::append(const BufferChain &chain) {
+    ASSERT(&chain != this);
+    chain.slice(0, chain.length, this);
+}
+
+void BufferChain::prepend(const void *buf, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    length += len;
+    if (!segs.empty()) {
+        Segment &seg = segs.front();
+        if (seg.block->isUnique() &&
+            static_cast<size_t>(seg.data - seg.block->begin()) >= len) {
+            seg.data -= len;
+            seg.len += len;
+            memcpy(seg.data, buf, len);
+            return;
+        }
+    }
+    // The data is put at the end of the block, to prepend more before it.
+    Segment seg;
+    seg.block = BufferBlock::create(len > blockSize ? len : blockSize);
+    seg.data = seg.block->end() - len;
+    seg.len = len;
+    memcpy(seg.data, buf, len);
+    segs.push_front(seg);
+}
+
+void BufferChain::slice(size_t offset, size_t len, BufferChain *out) const {
+    ASSERT(out);
+    if (offset > length || len > length - offset) {
+        throw BufferChainException(const_cast<BufferChain *>(this),
+            ERR_OVER_RANGE, "the range is out of the chain");
+    }
+    for (size_t i = 0; i < segs.size() && len; i++) {
+        const Segment &seg = segs[i];
+        if (offset >= seg.len) {
+            offset -= seg.len;
+            continue;
+        }
+        Segment part;
+        part.block = seg.block;
+        part.data = seg.data + offset;
+        part.len = seg.len - offset < len ? seg.len - offset : len;
+        part.block->ref();
+        out->segs.push_back(part);
+        out->length += part.len;
+        len -= part.len;
+        offset = 0;
+    }
+}
+
+void BufferChain::split(size_t len, BufferChain *out) {
+    ASSERT(out);
+    ASSERT(out != this);
+    if (len > length) {
+        throw BufferChainException(this, ERR_OVER_RANGE,
+            "the length is out of the chain");
+    }
+    length -= len;
+    out->length += len;
+    while (len) {
+        Segment &seg = segs.front();
+        if (seg.len <= len) {
+            // Move the whole segment, the reference moves with it.
+            len -= seg.len;
+            out->segs.push_back(seg);
+            segs.pop_front();
+            continue;
+        }
+        Segment part = seg;
+        part.len = len;
+        part.block->ref();
+        out->segs.push_back(part);
+        seg.data += len;
+        seg.len -= len;
+        break;
+    }
+}
+
+void BufferChain::consume(size_t len) {
+    if (len > length) {
+        throw BufferChainException(this, ERR_OVER_RANGE,
+            "the length is out of the chain");
+    }
+    length -= len;
+    while (len) {
+        Segment &seg = segs.front();
+        if (seg.len > len) {
+            seg.data += len;
+            seg.len -= len;
+            break;
+        }
+        len -= seg.len;
+        seg.block->unref();
+        segs.pop_front();
+    }
+}
+
+void BufferChain::clear() {
+    for (size_t i = 0; i < segs.size(); i++) {
+        segs[i].block->unref();
+    }
+    segs.clear();
+    length = 0;
+}
+
+const void *BufferChain::coalesce(size_t len) {
+    if (len > length) {
+        throw BufferChainException(this, ERR_OVER_RANGE,
+            "the length is out of the chain");
+    }
+    if (len == 0 || segs.front().len >= len) {
+        return segs.empty() ? nullptr : segs.front().data;
+    }
+    Segment seg;
+    seg.block = BufferBlock::create(len > blockSize ? len : blockSize);
+    seg.data = seg.block->begin();
+    seg.len = len;
+    copyOut(seg.data, len);
+    consume(len);
+    segs.push_front(seg);
+    length += len;
+    return seg.data;
+}
+
+size_t BufferChain::copyOut(void *buf, size_t len, size_t offset) const {
+    char *dst = static_cast<char *>(buf);
+    size_t copied = 0;
+
+    for (size_t i = 0; i < segs.size() && copied < len; i++) {
+        const Segment &seg = segs[i];
+        if (offset >= seg.len) {
+            offset -= seg.len;
+            continue;
+        }
+        size_t n = seg.len - offset;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        memcpy(dst + copied, seg.data + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+size_t BufferChain::getIoVecs(platform::IoVec *iov, size_t num) const {
+    size_t i;
+
+    ASSERT(iov);
+    for (i = 0; i < num && i < segs.size(); i++) {
+        iov[i].base = segs[i].data;
+        iov[i].len = segs[i].len;
+    }
+    return i;
+}
+
+size_t BufferChain::readFrom(platform::Handle *handle, size_t len) {
+    platform::IoVec iov[2];
+    size_t num = 0;
+    size_t room = 0;
+    BufferBlock *block = nullptr;
+
+    ASSERT(handle);
+    ASSERT(len);
+    char *tail = getTailRoom(&room);
+    if (tail) {
+        iov[num].base = tail;
+        iov[num].len = room < len ? room : len;
+        num++;
+    }
+    if (room < len) {
+        block = newBlock(len - room);
+        iov[num].base = block->begin();
+        iov[num].len = len - room < block->getSize() ?
+            len - room : block->getSize();
+        num++;
+    }
+
+    size_t n;
+    try {
+        n = handle->readv(iov, num);
+    } catch (...) {
+        if (block) {
+            keepBlock(block);
+        }
+        throw;
+    }
+    length += n;
+    size_t left = n;
+    if (tail) {
+        size_t used = left < room ? left : room;
+        segs.back().len += used;
+        left -= used;
+    }
+    if (left) {
+        Segment seg;
+        seg.block = block;
+        seg.data = block->begin();
+        seg.len = left;
+        segs.push_back(seg);
+    } else if (block) {
+        keepBlock(block);
+    }
+    return n;
+}
+
+size_t BufferChain::writeTo(platform::Handle *handle) {
+    platform::IoVec iov[BUFFER_CHAIN_IOV_MAX];
+
+    ASSERT(handle);
+    size_t num = getIoVecs(iov, BUFFER_CHAIN_IOV_MAX);
+    if (num == 0) {
+        return 0;
+    }
+    size_t n = handle->writev(iov, num);
+    consume(n);
+    return n;
+}
+
+}  // namespace common
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <cstring>
+#include <common/assert.hpp>
+#include <common/buffered_handle.hpp>
+
+namespace common {
+
+BufferedHandle::BufferedHandle(platform::Handle *handle,
+    size_t readSize, size_t writeSize):
+    handle(handle), rbuf(new char[readSize]), rsize(readSize), rpos(0),
+    rend(0), wbuf(new char[writeSize]), wsize(writeSize), wpos(0), wend(0) {
+    ASSERT(handle);
+    ASSERT(readSize);
+    ASSERT(writeSize);
+}
+
+BufferedHandle::~BufferedHandle() {
+    delete [] rbuf;
+    delete [] wbuf;
+}
+
+void BufferedHandle::fill() {
+    if (rpos == rend) {
+        rpos = rend = 0;
+    } else if (rend == rsize) {
+        // Move the buffered data to the front to read more.
+        memmove(rbuf, rbuf + rpos, rend - rpos);
+        rend -= rpos;
+        rpos = 0;
+    }
+    rend += handle->read(rbuf + rend, rsize - rend);
+}
+
+size_t BufferedHandle::read(void *buf, size_t len) {
+    ASSERT(buf);
+    ASSERT(len);
+    if (rpos == rend) {
+        // Large reads go to the handle directly.
+        if (len >= rsize) {
+            return handle->read(buf, len);
+        }
+        fill();
+    }
+    if (len > rend - rpos) {
+        len = rend - rpos;
+    }
+    memcpy(buf, rbuf + rpos, len);
+    rpos += len;
+    return len;
+}
+
+const void *BufferedHandle::peek(size_t len) {
+    ASSERT(len);
+    if (len > rsize) {
+        throw BufferedHandleException(this, ERR_OVER_RANGE,
+            "larger than the read buffer");
+    }
+    while (rend - rpos < len) {
+        if (rsize - rpos < len) {
+            memmove(rbuf, rbuf + rpos, rend - rpos);
+            rend -= rpos;
+            rpos = 0;
+        }
+        fill();
+    }
+    return rbuf + rpos;
+}
+
+void BufferedHandle::skip(size_t len) {
+    ASSERT(len <= rend - rpos);
+    rpos += len;
+}
+
+size_t BufferedHandle::readUntil(void *buf, size_t len, char delim) {
+    char *dst = static_cast<char *>(buf);
+    size_t copied = 0;
+
+    ASSERT(buf);
+    ASSERT(len);
+    while (copied < len) {
+        if (rpos == rend) {
+            if (copied) {
+                // Don't block with data read, the caller can read again.
+                try {
+                    fill();
+                } catch (platform::HandleException &e) {
+                    return copied;
+                }
+            } else {
+                fill();
+            }
+        }
+        size_t n = rend - rpos;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        const char *found = static_cast<const char *>(
+            memchr(rbuf + rpos, delim, n));
+        if (found) {
+            n = found - (rbuf + rpos) + 1;
+        }
+        memcpy(dst + copied, rbuf + rpos, n);
+        rpos += n;
+        copied += n;
+        if (found) {
+            break;
+        }
+    }
+    return copied;
+}
+
+size_t BufferedHandle::write(const void *buf, size_t len) {
+    const char *src = static_cast<const char *>(buf);
+    size_t accepted = 0;
+
+    ASSERT(buf);
+    ASSERT(len);
+    while (accepted < len) {
+        size_t n = len - accepted;
+        try {
+            if (wpos == wend) {
+                wpos = wend = 0;
+                // Large writes go to the handle directly.
+                if (n >= wsize) {
+                    accepted += handle->write(src + accepted, n);
+                    continue;
+                }
+            } else if (wend == wsize) {
+                flush();
+                continue;
+            }
+        } catch (platform::HandleException &e) {
+            if (accepted) {
+                return accepted;
+            }
+            throw;
+        }
+        if (n > wsize - wend) {
+            n = wsize - wend;
+        }
+        memcpy(wbuf + wend, src + accepted, n);
+        wend += n;
+        accepted += n;
+    }
+    return accepted;
+}
+
+void BufferedHandle::flush() {
+    while (wpos != wend) {
+        wpos += handle->write(wbuf + wpos, wend - wpos);
+    }
+    wpos = wend = 0;
+}
+
+}  // namespace common
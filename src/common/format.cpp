@@ -0,0 +1,611 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <common/exception.hpp>
+#include <common/format.hpp>
+
+/// The initial size of the buffer.
+#define FORMAT_BUF_INIT_SIZE 256
+
+/// The maximum precision formatted without the C library.
+#define FORMAT_FLOAT_PREC_MAX 9
+
+namespace common {
+
+/**
+ * @enum The flags of a conversion.
+*/
+enum FormatFlag {
+    FF_LEFT = (1 << 0),     ///< '-', left-justify
+    FF_PLUS = (1 << 1),     ///< '+', always a sign
+    FF_SPACE = (1 << 2),    ///< ' ', a space if no sign
+    FF_ALT = (1 << 3),      ///< '#', the alternate form
+    FF_ZERO = (1 << 4),     ///< '0', pad with zeros
+};
+
+/**
+ * @enum The length modifiers of a conversion.
+*/
+enum FormatLength {
+    FL_NONE,
+    FL_HH,
+    FL_H,
+    FL_L,
+    FL_LL,
+    FL_J,
+    FL_Z,
+    FL_T,
+    FL_LD,
+};
+
+static const char digitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const u64 pow10s[FORMAT_FLOAT_PREC_MAX + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000,
+};
+
+/**
+ * @brief Write the digits of the value backward from the end.
+ *
+ * @return the first digit.
+*/
+static char *formatU64(char *end, u64 value, int base, bool upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char *p = end;
+
+    if (base == 10) {
+        // Two digits at a time.
+        while (value >= 100) {
+            size_t i = (value % 100) * 2;
+            value /= 100;
+            *--p = digitPairs[i + 1];
+            *--p = digitPairs[i];
+        }
+        if (value >= 10) {
+            size_t i = value * 2;
+            *--p = digitPairs[i + 1];
+            *--p = digitPairs[i];
+        } else {
+            *--p = static_cast<char>('0' + value);
+        }
+        return p;
+    }
+    int shift = base == 16 ? 4 : 3;
+    do {
+        *--p = digits[value & (base - 1)];
+        value >>= shift;
+    } while (value);
+    return p;
+}
+
+static s64 fetchSigned(va_list *ap, int length) {
+    switch (length) {
+    case FL_HH:
+        return static_cast<signed char>(va_arg(*ap, int));
+    case FL_H:
+        return static_cast<short>(va_arg(*ap, int));  // NOLINT
+    case FL_L:
+        return va_arg(*ap, long);  // NOLINT
+    case FL_LL:
+        return va_arg(*ap, long long);  // NOLINT
+    case FL_J:
+        return va_arg(*ap, intmax_t);
+    case FL_Z:
+        return va_arg(*ap, ssize_t);
+    case FL_T:
+        return va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, int);
+    }
+}
+
+static u64 fetchUnsigned(va_list *ap, int length) {
+    switch (length) {
+    case FL_HH:
+        return static_cast<unsigned char>(va_arg(*ap, unsigned));
+    case FL_H:
+        return static_cast<unsigned short>(va_arg(*ap, unsigned));  // NOLINT
+    case FL_L:
+        return va_arg(*ap, unsigned long);  // NOLINT
+    case FL_LL:
+        return va_arg(*ap, unsigned long long);  // NOLINT
+    case FL_J:
+        return va_arg(*ap, uintmax_t);
+    case FL_Z:
+        return va_arg(*ap, size_t);
+    case FL_T:
+        return va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, unsigned);
+    }
+}
+
+static void storeCount(va_list *ap, int length, size_t count) {
+    switch (length) {
+    case FL_HH:
+        *va_arg(*ap, signed char *) = static_cast<signed char>(count);
+        break;
+    case FL_H:
+        *va_arg(*ap, short *) = static_cast<short>(count);  // NOLINT
+        break;
+    case FL_L:
+        *va_arg(*ap, long *) = static_cast<long>(count);  // NOLINT
+        break;
+    case FL_LL:
+        *va_arg(*ap, long long *) = count;  // NOLINT
+        break;
+    case FL_J:
+        *va_arg(*ap, intmax_t *) = count;
+        break;
+    case FL_Z:
+        *va_arg(*ap, ssize_t *) = count;
+        break;
+    case FL_T:
+        *va_arg(*ap, ptrdiff_t *) = count;
+        break;
+    default:
+        *va_arg(*ap, int *) = static_cast<int>(count);
+        break;
+    }
+}
+
+/**
+ * @brief Build a format string of a floating-point conversion, the width
+ * and the precision are given as arguments.
+*/
+static void buildFloatSpec(char *spec, int flags, bool ld, int conv) {
+    char *p = spec;
+
+    *p++ = '%';
+    if (flags & FF_LEFT) {
+        *p++ = '-';
+    }
+    if (flags & FF_PLUS) {
+        *p++ = '+';
+    }
+    if (flags & FF_SPACE) {
+        *p++ = ' ';
+    }
+    if (flags & FF_ALT) {
+        *p++ = '#';
+    }
+    if (flags & FF_ZERO) {
+        *p++ = '0';
+    }
+    *p++ = '*';
+    *p++ = '.';
+    *p++ = '*';
+    if (ld) {
+        *p++ = 'L';
+    }
+    *p++ = static_cast<char>(conv);
+    *p = '\0';
+}
+
+FormatBuffer::~FormatBuffer() {
+    free(buf);
+}
+
+void FormatBuffer::grow(size_t size) {
+    size_t newCap = cap ? cap : FORMAT_BUF_INIT_SIZE;
+    while (newCap < size) {
+        newCap *= 2;
+    }
+    char *p = static_cast<char *>(realloc(buf, newCap));
+    if (p == nullptr) {
+        throw Exception(ERR_MEM, "failed to grow the format buffer");
+    }
+    buf = p;
+    cap = newCap;
+}
+
+void FormatBuffer::append(const char *str, size_t n) {
+    memcpy(reserve(n), str, n);
+    len += n;
+    buf[len] = '\0';
+}
+
+void FormatBuffer::fill(char c, size_t n) {
+    memset(reserve(n), c, n);
+    len += n;
+    buf[len] = '\0';
+}
+
+void FormatBuffer::formatBody(int flags, int width, const char *prefix,
+    size_t prefixLen, size_t zeros, const char *body, size_t bodyLen) {
+    size_t total = prefixLen + zeros + bodyLen;
+    size_t pad = static_cast<size_t>(width) > total ? width - total : 0;
+    char *p = reserve(total + pad);
+
+    len += total + pad;
+    if (!(flags & FF_LEFT) && pad) {
+        if (flags & FF_ZERO) {
+            zeros += pad;
+        } else {
+            memset(p, ' ', pad);
+            p += pad;
+        }
+        pad = 0;
+    }
+    // Mostly a sign or nothing, and a few zeros.
+    for (size_t i = 0; i < prefixLen; i++) {
+        *p++ = prefix[i];
+    }
+    for (size_t i = 0; i < zeros; i++) {
+        *p++ = '0';
+    }
+    memcpy(p, body, bodyLen);
+    if (pad) {
+        memset(p + bodyLen, ' ', pad);
+    }
+}
+
+void FormatBuffer::formatInt(int flags, int width, int prec,
+    u64 value, bool neg, int conv) {
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char prefix[2];
+    size_t prefixLen = 0;
+    int base = 10;
+
+    if (conv == 'o') {
+        base = 8;
+    } else if (conv == 'x' || conv == 'X' || conv == 'p') {
+        base = 16;
+    }
+    char *start = formatU64(end, value, base, conv == 'X');
+    if (prec == 0 && value == 0) {
+        start = end;
+    }
+    size_t n = end - start;
+
+    if (neg) {
+        prefix[prefixLen++] = '-';
+    } else if (conv == 'd' || conv == 'i') {
+        if (flags & FF_PLUS) {
+            prefix[prefixLen++] = '+';
+        } else if (flags & FF_SPACE) {
+            prefix[prefixLen++] = ' ';
+        }
+    }
+    if (prec >= 0) {
+        flags &= ~FF_ZERO;
+    }
+    if (conv == 'p' || ((flags & FF_ALT) && base == 16 && value)) {
+        prefix[prefixLen++] = '0';
+        prefix[prefixLen++] = conv == 'X' ? 'X' : 'x';
+    } else if ((flags & FF_ALT) && base == 8 &&
+        (n == 0 || *start != '0') && prec <= static_cast<int>(n)) {
+        // The first digit of the alternate octal form is 0.
+        prec = n + 1;
+    }
+    formatBody(flags, width, prefix, prefixLen,
+        prec > static_cast<int>(n) ? prec - n : 0, start, n);
+}
+
+void FormatBuffer::formatStr(int flags, int width, int prec,
+    const char *str) {
+    if (str == nullptr) {
+        str = "(null)";
+    }
+    size_t n = prec >= 0 ? strnlen(str, prec) : strlen(str);
+    formatBody(flags & ~FF_ZERO, width, "", 0, 0, str, n);
+}
+
+bool FormatBuffer::formatFloat(int flags, int width, int prec,
+    double value) {
+#if LDBL_MANT_DIG >= 64
+    char tmp[32];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    char prefix;
+    size_t prefixLen = 1;
+
+    if (prec < 0) {
+        prec = 6;
+    }
+    if (prec > FORMAT_FLOAT_PREC_MAX || !std::isfinite(value)) {
+        return false;
+    }
+    // The error of the product is less than 2^-12 below 2^52,
+    // so the rounding is right unless it's close to a tie.
+    long double scaled = fabsl(value) * pow10s[prec];
+    if (!(scaled < 4503599627370496.0L)) {
+        return false;
+    }
+    u64 digits = static_cast<u64>(scaled);
+    long double frac = scaled - digits;
+    if (fabsl(frac - 0.5L) < 1e-3L) {
+        return false;
+    }
+    if (frac > 0.5L) {
+        digits++;
+    }
+
+    if (prec) {
+        u64 fracDigits = digits % pow10s[prec];
+        char *start = formatU64(p, fracDigits, 10, false);
+        while (p - start < prec) {
+            *--start = '0';
+        }
+        p = start;
+        *--p = '.';
+    } else if (flags & FF_ALT) {
+        *--p = '.';
+    }
+    p = formatU64(p, digits / pow10s[prec], 10, false);
+
+    if (std::signbit(value)) {
+        prefix = '-';
+    } else if (flags & FF_PLUS) {
+        prefix = '+';
+    } else if (flags & FF_SPACE) {
+        prefix = ' ';
+    } else {
+        prefixLen = 0;
+    }
+    formatBody(flags, width, &prefix, prefixLen, 0, p, end - p);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FormatBuffer::formatFloatLib(int flags, int width, int prec, int conv,
+    double value) {
+    char spec[16];
+
+    buildFloatSpec(spec, flags, false, conv);
+    int n = snprintf(nullptr, 0, spec, width, prec, value);
+    if (n > 0) {
+        snprintf(reserve(n), n + 1, spec, width, prec, value);
+        len += n;
+    }
+}
+
+void FormatBuffer::formatFloatLib(int flags, int width, int prec, int conv,
+    long double value) {
+    char spec[16];
+
+    buildFloatSpec(spec, flags, true, conv);
+    int n = snprintf(nullptr, 0, spec, width, prec, value);
+    if (n > 0) {
+        snprintf(reserve(n), n + 1, spec, width, prec, value);
+        len += n;
+    }
+}
+
+void FormatBuffer::format(const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    try {
+        vformat(fmt, ap);
+    } catch (...) {
+        va_end(ap);
+        throw;
+    }
+    va_end(ap);
+}
+
+void FormatBuffer::vformat(const char *fmt, va_list args) {
+    size_t start = len;
+    const char *fmtStart = fmt;
+    va_list ap;
+    int n;
+
+    va_copy(ap, args);
+    reserve(0);
+    for (;;) {
+        const char *pct = strchr(fmt, '%');
+        if (pct == nullptr) {
+            n = strlen(fmt);
+            memcpy(reserve(n), fmt, n);
+            len += n;
+            break;
+        }
+        memcpy(reserve(pct - fmt), fmt, pct - fmt);
+        len += pct - fmt;
+
+        const char *p = pct + 1;
+        int flags = 0;
+        int width = 0;
+        int prec = -1;
+        int length = FL_NONE;
+        for (;; p++) {
+            if (*p == '-') {
+                flags |= FF_LEFT;
+            } else if (*p == '+') {
+                flags |= FF_PLUS;
+            } else if (*p == ' ') {
+                flags |= FF_SPACE;
+            } else if (*p == '#') {
+                flags |= FF_ALT;
+            } else if (*p == '0') {
+                flags |= FF_ZERO;
+            } else {
+                break;
+            }
+        }
+        if (*p == '*') {
+            width = va_arg(ap, int);
+            if (width < 0) {
+                flags |= FF_LEFT;
+                width = -width;
+            }
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                width = width * 10 + (*p++ - '0');
+            }
+        }
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                prec = va_arg(ap, int);
+                if (prec < 0) {
+                    prec = -1;
+                }
+                p++;
+            } else {
+                prec = 0;
+                while (*p >= '0' && *p <= '9') {
+                    prec = prec * 10 + (*p++ - '0');
+                }
+            }
+        }
+        switch (*p) {
+        case 'h':
+            length = p[1] == 'h' ? FL_HH : FL_H;
+            break;
+        case 'l':
+            length = p[1] == 'l' ? FL_LL : FL_L;
+            break;
+        case 'q':
+            length = FL_LL;
+            break;
+        case 'j':
+            length = FL_J;
+            break;
+        case 'z':
+            length = FL_Z;
+            break;
+        case 't':
+            length = FL_T;
+            break;
+        case 'L':
+            length = FL_LD;
+            break;
+        }
+        if (length == FL_HH || length == FL_LL) {
+            p += *p == 'q' ? 1 : 2;
+        } else if (length != FL_NONE) {
+            p++;
+        }
+        if (flags & FF_LEFT) {
+            flags &= ~FF_ZERO;
+        }
+
+        int conv = *p++;
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            s64 value = fetchSigned(&ap, length);
+            bool neg = value < 0;
+            formatInt(flags, width, prec,
+                neg ? 0 - static_cast<u64>(value) : value, neg, conv);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            formatInt(flags, width, prec, fetchUnsigned(&ap, length),
+                false, conv);
+            break;
+        case 'c': {
+            if (length == FL_L) {
+                goto fallback;
+            }
+            char c = static_cast<char>(va_arg(ap, int));
+            formatBody(flags & ~FF_ZERO, width, "", 0, 0, &c, 1);
+            break;
+        }
+        case 's':
+            if (length == FL_L) {
+                goto fallback;
+            }
+            formatStr(flags, width, prec, va_arg(ap, const char *));
+            break;
+        case 'p': {
+            void *ptr = va_arg(ap, void *);
+            if (ptr == nullptr) {
+                formatStr(flags, width, -1, "(nil)");
+            } else {
+                formatInt(flags, width, prec,
+                    reinterpret_cast<uintptr_t>(ptr), false, conv);
+            }
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (length == FL_LD) {
+                formatFloatLib(flags, width, prec, conv,
+                    va_arg(ap, long double));
+            } else {
+                double value = va_arg(ap, double);
+                if ((conv != 'f' && conv != 'F') ||
+                    !formatFloat(flags, width, prec, value)) {
+                    formatFloatLib(flags, width, prec, conv, value);
+                }
+            }
+            break;
+        case '%':
+            *reserve(1) = '%';
+            len++;
+            break;
+        case 'n':
+            storeCount(&ap, length, len - start);
+            break;
+        default:
+            // Such as the positional arguments.
+            goto fallback;
+        }
+        fmt = p;
+    }
+    va_end(ap);
+    buf[len] = '\0';
+    return;
+
+fallback:
+    va_end(ap);
+    len = start;
+    va_copy(ap, args);
+    n = vsnprintf(nullptr, 0, fmtStart, ap);
+    va_end(ap);
+    if (n > 0) {
+        va_copy(ap, args);
+        vsnprintf(reserve(n), n + 1, fmtStart, ap);
+        va_end(ap);
+        len += n;
+    }
+    buf[len] = '\0';
+}
+
+}  // namespace common
@@ -19,6 +19,8 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
 */
+#include <cstdio>
+#include <common/format.hpp>
 #include <common/log.hpp>
 #include <platform/args.hpp>
 #include <platform/handle.hpp>
@@ -66,19 +68,47 @@ static const char *getLogLevelString(Log::Level level) {
     }
 }
 
+/**
+ * @brief Clamp the result of vsnprintf() to the length in the buffer.
+*/
+static size_t getPrintLen(int size, size_t bufSize) {
+    if (size <= 0) {
+        return 0;
+    }
+    return static_cast<size_t>(size) < bufSize ?
+        static_cast<size_t>(size) : bufSize - 1;
+}
+
 void Log::put(Level level, const char *fmt, ...) {
     va_list ap;
     char clock_str[CLOCK_FORMAT_STRING_LEN];
+    char prefix[CLOCK_FORMAT_STRING_LEN + 8];
+    // The message is formatted in a buffer of the thread, it only grows.
+    static thread_local FormatBuffer msg;
+    char newline[] = "\n";
+    platform::IoVec iov[3];
     platform::Handle *handle = logPriv.handle;
 
     if (level <= logPriv.level) {
         platform::Clock::Instance().getFormat(clock_str, sizeof(clock_str));
-        handle->print("[%s] %s ",
-            getLogLevelString(level), clock_str);
+        iov[0].base = prefix;
+        iov[0].len = getPrintLen(snprintf(prefix, sizeof(prefix), "[%s] %s ",
+            getLogLevelString(level), clock_str), sizeof(prefix));
+        msg.clear();
         va_start(ap, fmt);
-        handle->vprint(fmt, ap);
+        try {
+            msg.vformat(fmt, ap);
+        } catch (...) {
+            va_end(ap);
+            throw;
+        }
         va_end(ap);
-        handle->print("\n");
+        iov[1].base = const_cast<char *>(msg.getData());
+        iov[1].len = msg.getLength();
+        iov[2].base = newline;
+        iov[2].len = 1;
+        // The prefix, the message and the newline in one system call.
+        handle->writevAll(iov, ARRAY_LEN(iov));
     }
 }
 
@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <climits>
+#include <common/timer_wheel.hpp>
+#include <common/assert.hpp>
+
+/// The number of bits of the root level index.
+#define TIMER_WHEEL_ROOT_BITS 8
+/// The number of bits of the higher level index.
+#define TIMER_WHEEL_LEVEL_BITS 6
+/// The number of levels above the root.
+#define TIMER_WHEEL_LEVEL_NUM 4
+
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_ROOT_MASK (TIMER_WHEEL_ROOT_SIZE - 1)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVEL_MASK (TIMER_WHEEL_LEVEL_SIZE - 1)
+#define TIMER_WHEEL_SLOT_NUM \
+    (TIMER_WHEEL_ROOT_SIZE + TIMER_WHEEL_LEVEL_NUM * TIMER_WHEEL_LEVEL_SIZE)
+
+/// The max delay of a timer.
+#define TIMER_WHEEL_MAX_DELAY 0xffffffffULL
+
+namespace common {
+
+/**
+ * @brief Get the slot index of the time in the level(1 ~ LEVEL_NUM).
+*/
+static inline u32 getLevelIndex(u64 time, int level) {
+    return (time >> (TIMER_WHEEL_ROOT_BITS +
+        (level - 1) * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_LEVEL_MASK;
+}
+
+/**
+ * @brief Get the slot of the level(0 ~ LEVEL_NUM), level 0 is the root.
+*/
+static inline Timer *getSlot(Timer *slots, int level, u32 index) {
+    if (level == 0) {
+        return slots + index;
+    }
+    return slots + TIMER_WHEEL_ROOT_SIZE +
+        (level - 1) * TIMER_WHEEL_LEVEL_SIZE + index;
+}
+
+Timer::~Timer() {
+    if (wheel) {
+        wheel->del(this);
+    }
+}
+
+TimerWheel::TimerWheel(u64 now): current(now), count(0) {
+    slots = new Timer[TIMER_WHEEL_SLOT_NUM];
+}
+
+TimerWheel::~TimerWheel() {
+    // Detach the pending timers, they may be destroyed after the wheel.
+    for (int i = 0; i < TIMER_WHEEL_SLOT_NUM; i++) {
+        Timer *head = slots + i;
+        while (head->next != head) {
+            Timer *timer = head->next;
+            head->next = timer->next;
+            timer->prev = timer->next = timer;
+            timer->wheel = nullptr;
+        }
+        head->prev = head;
+    }
+    delete [] slots;
+}
+
+void TimerWheel::add(Timer *timer, u64 expires, Timer::cb_t cb, void *arg) {
+    ASSERT(timer);
+    ASSERT(cb);
+    if (timer->wheel) {
+        timer->wheel->del(timer);
+    }
+    if (expires > current && expires - current > TIMER_WHEEL_MAX_DELAY) {
+        expires = current + TIMER_WHEEL_MAX_DELAY;
+    }
+    timer->wheel = this;
+    timer->expires = expires;
+    timer->cb = cb;
+    timer->arg = arg;
+    count++;
+    enqueue(timer);
+}
+
+void TimerWheel::del(Timer *timer) {
+    ASSERT(timer);
+    if (!timer->wheel) {
+        return;
+    }
+    ASSERT(timer->wheel == this);
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = timer;
+    timer->wheel = nullptr;
+    count--;
+}
+
+void TimerWheel::enqueue(Timer *timer) {
+    u64 expires = timer->expires;
+    Timer *head;
+
+    if (expires < current) {
+        // Already expired, run it in the next slot.
+        head = getSlot(slots, 0, current & TIMER_WHEEL_ROOT_MASK);
+    } else {
+        u64 delta = expires - current;
+        int level = 0;
+        u64 span = TIMER_WHEEL_ROOT_SIZE;
+        while (delta >= span && level < TIMER_WHEEL_LEVEL_NUM) {
+            level++;
+            span <<= TIMER_WHEEL_LEVEL_BITS;
+        }
+        if (level == 0) {
+            head = getSlot(slots, 0, expires & TIMER_WHEEL_ROOT_MASK);
+        } else {
+            head = getSlot(slots, level, getLevelIndex(expires, level));
+        }
+    }
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+u32 TimerWheel::cascade(int level) {
+    u32 index = getLevelIndex(current, level);
+    Timer *head = getSlot(slots, level, index);
+    Timer *timer = head->next;
+
+    head->prev = head->next = head;
+    while (timer != head) {
+        Timer *next = timer->next;
+        enqueue(timer);
+        timer = next;
+    }
+    return index;
+}
+
+void TimerWheel::run(u64 now) {
+    Timer work;
+
+    while (current <= now) {
+        if (!count) {
+            current = now + 1;
+            break;
+        }
+        u32 index = current & TIMER_WHEEL_ROOT_MASK;
+        if (!index) {
+            for (int level = 1; level <= TIMER_WHEEL_LEVEL_NUM; level++) {
+                if (cascade(level)) {
+                    break;
+                }
+            }
+        }
+        Timer *head = getSlot(slots, 0, index);
+        if (head->next == head) {
+            current++;
+            continue;
+        }
+        // Move the slot to the work list, the timers added by callbacks
+        // must not be run in this slot.
+        work.next = head->next;
+        work.prev = head->prev;
+        work.next->prev = &work;
+        work.prev->next = &work;
+        head->prev = head->next = head;
+        current++;
+        try {
+            while (work.next != &work) {
+                Timer *timer = work.next;
+                del(timer);
+                timer->cb(timer, timer->arg);
+            }
+        } catch (...) {
+            // Put the rest back to the wheel, they run in the next run().
+            while (work.next != &work) {
+                Timer *timer = work.next;
+                work.next = timer->next;
+                timer->next->prev = &work;
+                enqueue(timer);
+            }
+            throw;
+        }
+    }
+}
+
+int TimerWheel::getTimeout(u64 now) const {
+    u32 index = current & TIMER_WHEEL_ROOT_MASK;
+    u64 expires;
+    u32 i;
+
+    if (!count) {
+        return -1;
+    }
+    for (i = index; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+        Timer *head = slots + i;
+        if (head->next != head) {
+            break;
+        }
+    }
+    if (i == TIMER_WHEEL_ROOT_SIZE && !index) {
+        // The higher levels are not cascaded yet.
+        expires = current;
+    } else {
+        // Wait until the next cascade if no timer in the rest of the root.
+        expires = current + (i - index);
+    }
+    if (expires <= now) {
+        return 0;
+    }
+    if (expires - now > INT_MAX) {
+        return INT_MAX;
+    }
+    return static_cast<int>(expires - now);
+}
+
+}  // namespace common
@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+#include <common/assert.hpp>
+#include <platform/file_io.hpp>
+#include <platform/handle_int.hpp>
+
+namespace platform {
+
+/**
+ * @brief A pending file I/O.
+*/
+class FileIoRequest {
+ public:
+    FileIoRequest(): write(false), fd(-1), buf(nullptr), len(0), offset(0),
+        poll(nullptr), cb(nullptr), arg(nullptr), err(common::ERR_OK),
+        done(0), next(nullptr) {}
+
+    bool write;
+    int fd;
+    char *buf;
+    size_t len;
+    u64 offset;
+    Poll *poll;
+    FileIo::cb_t cb;
+    void *arg;
+    common::ErrorCode err;
+    size_t done;            ///< the number of bytes transferred
+    FileIoRequest *next;
+};
+
+class FileIoPriv {
+ public:
+    explicit FileIoPriv(u32 num): num(num), stopping(false),
+        head(nullptr), tail(nullptr) {
+        pthread_mutex_init(&mutex, nullptr);
+        pthread_cond_init(&cond, nullptr);
+        threads = new pthread_t[num];
+    }
+
+    ~FileIoPriv() {
+        delete [] threads;
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void submit(FileIoRequest *req);
+    FileIoRequest *take();
+
+    u32 num;
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stopping;
+    FileIoRequest *head;    ///< the first request in the queue
+    FileIoRequest *tail;    ///< the last request in the queue
+};
+
+void FileIoPriv::submit(FileIoRequest *req) {
+    pthread_mutex_lock(&mutex);
+    if (tail) {
+        tail->next = req;
+    } else {
+        head = req;
+    }
+    tail = req;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+FileIoRequest *FileIoPriv::take() {
+    FileIoRequest *req;
+
+    pthread_mutex_lock(&mutex);
+    while (head == nullptr && !stopping) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    // The queued requests are finished before stopping.
+    req = head;
+    if (req) {
+        head = req->next;
+        if (head == nullptr) {
+            tail = nullptr;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return req;
+}
+
+static void runRequest(FileIoRequest *req) {
+    while (req->done < req->len) {
+        ssize_t ret;
+        if (req->write) {
+            ret = pwrite(req->fd, req->buf + req->done, req->len - req->done,
+                static_cast<off_t>(req->offset + req->done));
+        } else {
+            ret = pread(req->fd, req->buf + req->done, req->len - req->done,
+                static_cast<off_t>(req->offset + req->done));
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            req->err = getRwError(errno);
+            break;
+        }
+        if (ret == 0) {
+            // The end of the file.
+            break;
+        }
+        req->done += ret;
+    }
+}
+
+/**
+ * @brief Run the callback in the thread of the poll.
+*/
+static void completeRequest(void *arg) {
+    FileIoRequest *req = static_cast<FileIoRequest *>(arg);
+    req->cb(req->err, req->done, req->arg);
+    delete req;
+}
+
+static void *fileIoThreadEntry(void *arg) {
+    FileIoPriv *priv = static_cast<FileIoPriv *>(arg);
+    FileIoRequest *req;
+
+    while ((req = priv->take()) != nullptr) {
+        runRequest(req);
+        req->poll->post(completeRequest, req);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Stop the worker threads after the queued requests are finished.
+*/
+static void stopThreads(FileIoPriv *priv, u32 num) {
+    pthread_mutex_lock(&priv->mutex);
+    priv->stopping = true;
+    pthread_cond_broadcast(&priv->cond);
+    pthread_mutex_unlock(&priv->mutex);
+    for (u32 i = 0; i < num; i++) {
+        pthread_join(priv->threads[i], nullptr);
+    }
+}
+
+FileIo::FileIo(u32 num): priv(new FileIoPriv(num ? num : 1)) {
+    for (u32 i = 0; i < priv->num; i++) {
+        if (pthread_create(&priv->threads[i], nullptr,
+            fileIoThreadEntry, priv)) {
+            stopThreads(priv, i);
+            delete priv;
+            throw FileIoException(this, common::ERR_MEM,
+                "failed to create the file I/O thread");
+        }
+    }
+}
+
+FileIo::~FileIo() {
+    stopThreads(priv, priv->num);
+    delete priv;
+}
+
+void FileIo::read(Poll *poll, FileHandle *file, void *buf, size_t len,
+    u64 offset, cb_t cb, void *arg) {
+    FileIoRequest *req = new FileIoRequest;
+
+    ASSERT(poll);
+    ASSERT(file);
+    ASSERT(cb);
+    req->fd = file->priv->fd;
+    req->buf = static_cast<char *>(buf);
+    req->len = len;
+    req->offset = offset;
+    req->poll = poll;
+    req->cb = cb;
+    req->arg = arg;
+    priv->submit(req);
+}
+
+void FileIo::write(Poll *poll, FileHandle *file, const void *buf, size_t len,
+    u64 offset, cb_t cb, void *arg) {
+    FileIoRequest *req = new FileIoRequest;
+
+    ASSERT(poll);
+    ASSERT(file);
+    ASSERT(cb);
+    req->write = true;
+    req->fd = file->priv->fd;
+    req->buf = static_cast<char *>(const_cast<void *>(buf));
+    req->len = len;
+    req->offset = offset;
+    req->poll = poll;
+    req->cb = cb;
+    req->arg = arg;
+    priv->submit(req);
+}
+
+u32 FileIo::getSize() const {
+    return priv->num;
+}
+
+}  // namespace platform
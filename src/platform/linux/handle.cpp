@@ -21,16 +21,43 @@
 */
 #include <fcntl.h>
 #include <unistd.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <cerrno>
 #include <common/assert.hpp>
+#include <common/format.hpp>
 #include <platform/args.hpp>
 #include <platform/handle.hpp>
 #include <platform/handle_int.hpp>
 #include <platform/error.hpp>
 
-/// The size of handle buffer
-#define PFM_HANDLE_BUF_SIZE 4096
+/// The maximum number of datagrams in one batch.
+#define PFM_SOCKET_BATCH_MAX 64
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
 
 namespace platform {
 
@@ -59,8 +86,89 @@ static const ErrorDesc rwErrDescs[] = {
     {EFAULT, common::ERR_OVER_RANGE,
         "buf is outside your accessible address space"},
     {EINTR, common::ERR_INTR, "The call was interrupted by a signal"},
+    {EBADF, common::ERR_PERM, "the handle is not open for the operation"},
+    {EDQUOT, common::ERR_DQUOT, "no space left or the quota is exhausted"},
+    {ENOSPC, common::ERR_DQUOT, "no space left or the quota is exhausted"},
+    {ENOMEM, common::ERR_MEM, "no memory"},
+};
+
+static const ErrorDesc sockErrDescs[] = {
+    {EAGAIN, common::ERR_AGAIN, "the socket is not ready, try again"},
+    {EINTR, common::ERR_INTR, "The call was interrupted by a signal"},
+    {EACCES, common::ERR_PERM, "permission denied"},
+    {EPERM, common::ERR_PERM, "permission denied"},
+    {EADDRINUSE, common::ERR_EXIST, "the address is already in use"},
+    {EADDRNOTAVAIL, common::ERR_NOENT, "the address is not available"},
+    {ECONNREFUSED, common::ERR_ERR, "the connection is refused"},
+    {ECONNRESET, common::ERR_ERR, "the connection is reset by the peer"},
+    {ETIMEDOUT, common::ERR_ERR, "the connection timed out"},
+    {ENETUNREACH, common::ERR_ERR, "the network is unreachable"},
+    {EMFILE, common::ERR_MEM, "too many open files"},
+    {ENFILE, common::ERR_MEM, "too many open files"},
+    {ENOBUFS, common::ERR_MEM, "no buffer space"},
+    {ENOMEM, common::ERR_MEM, "no memory"},
+    {EMSGSIZE, common::ERR_OVER_RANGE, "the message is too long"},
+    {EINVAL, common::ERR_INVAL_ARG, "invalid argument"},
 };
 
+static_assert(sizeof(IoVec) == sizeof(struct iovec) &&
+    offsetof(IoVec, base) == offsetof(struct iovec, iov_base) &&
+    offsetof(IoVec, len) == offsetof(struct iovec, iov_len),
+    "IoVec must have the same layout as struct iovec");
+
+/**
+ * @brief Get the error code of a failed read or write, the errors of
+ * the non-blocking handles are checked before the table.
+*/
+common::ErrorCode getRwError(int err) {
+    if (err == EAGAIN || err == EWOULDBLOCK) {
+        return common::ERR_AGAIN;
+    }
+    if (err == EINTR) {
+        return common::ERR_INTR;
+    }
+    const ErrorDesc *desc = getErrorDesc(err,
+        rwErrDescs, ARRAY_LEN(rwErrDescs));
+    return desc ? desc->err : common::ERR_ERR;
+}
+
+/**
+ * @brief Make the result of a read or write.
+*/
+static IoResult makeIoResult(ssize_t ret) {
+    IoResult result;
+    if (ret >= 0) {
+        result.len = static_cast<size_t>(ret);
+        result.err = common::ERR_OK;
+    } else {
+        result.len = 0;
+        result.err = getRwError(errno);
+    }
+    return result;
+}
+
+/**
+ * @brief Throw the error of a read or write which transferred nothing.
+*/
+static void throwIoResult(Handle *handle, const IoResult &result) {
+    if (result.err == common::ERR_OK) {
+        throw HandleException(handle, common::ERR_ERR, "end of file");
+    }
+    for (size_t i = 0; i < ARRAY_LEN(rwErrDescs); i++) {
+        if (rwErrDescs[i].err == result.err) {
+            throw HandleException(handle, result.err, rwErrDescs[i].msg);
+        }
+    }
+    throw HandleException(handle, result.err);
+}
+
+/**
+ * @brief Throw the error of a failed read or write.
+*/
+static void throwRwError(Handle *handle, ssize_t ret) {
+    throwIoResult(handle, makeIoResult(ret));
+}
+
 Handle *Handle::in() {
     if (inHandle == nullptr) {
         inHandle = new Handle;
@@ -87,61 +195,247 @@ Handle *Handle::err() {
 
 void Handle::print(const char *fmt, ...) {
     va_list ap;
-    int size;
-    char buf[PFM_HANDLE_BUF_SIZE];
 
     va_start(ap, fmt);
-    size = vsnprintf(buf, sizeof(buf), fmt, ap);
-    if (size <= 0) {
-        throw HandleException(this, common::ERR_ERR);
-        goto end;
+    try {
+        vprint(fmt, ap);
+    } catch (...) {
+        va_end(ap);
+        throw;
     }
-    write(buf, size);
-end:
     va_end(ap);
 }
 
 void Handle::vprint(const char *fmt, va_list args) {
-    int size;
-    char buf[PFM_HANDLE_BUF_SIZE];
+    // Formatted in a buffer of the thread, it only grows.
+    static thread_local common::FormatBuffer buf;
+    IoVec vec;
 
-    size = vsnprintf(buf, sizeof(buf), fmt, args);
-    if (size <= 0) {
-        throw HandleException(this, common::ERR_ERR);
+    buf.clear();
+    buf.vformat(fmt, args);
+    if (buf.getLength() == 0) {
         return;
     }
-    write(buf, size);
+    vec.base = const_cast<char *>(buf.getData());
+    vec.len = buf.getLength();
+    writevAll(&vec, 1);
 }
 
 Handle::Handle(): priv(new HandlePriv) {}
 
 Handle::~Handle() {
     close(priv->fd);
+    if (priv->pipe[0] >= 0) {
+        close(priv->pipe[0]);
+        close(priv->pipe[1]);
+    }
     delete priv;
 }
 
+IoResult Handle::tryWrite(const void *buf, size_t len) {
+    return makeIoResult(::write(priv->fd, buf, len));
+}
+
+IoResult Handle::tryRead(void *buf, size_t len) {
+    return makeIoResult(::read(priv->fd, buf, len));
+}
+
+IoResult Handle::tryWritev(const IoVec *iov, size_t cnt) {
+    ASSERT(iov);
+    if (cnt > IOV_MAX) {
+        cnt = IOV_MAX;
+    }
+    return makeIoResult(::writev(priv->fd,
+        reinterpret_cast<const struct iovec *>(iov), static_cast<int>(cnt)));
+}
+
+IoResult Handle::tryReadv(const IoVec *iov, size_t cnt) {
+    ASSERT(iov);
+    if (cnt > IOV_MAX) {
+        cnt = IOV_MAX;
+    }
+    return makeIoResult(::readv(priv->fd,
+        reinterpret_cast<const struct iovec *>(iov), static_cast<int>(cnt)));
+}
+
 size_t Handle::write(const void *buf, size_t len) {
-    ssize_t wlen;
-    wlen = ::write(priv->fd, buf, len);
-    if (wlen <= 0) {
-        const ErrorDesc *desc = getErrorDesc(errno,
-            rwErrDescs, ARRAY_LEN(rwErrDescs));
-        throw HandleException(this, desc->err, desc->msg);
-        return 0;
+    IoResult result = tryWrite(buf, len);
+    if (result.len == 0) {
+        throwIoResult(this, result);
     }
-    return static_cast<size_t>(wlen);
+    return result.len;
 }
 
 size_t Handle::read(void *buf, size_t len) {
-    ssize_t rlen;
-    rlen = ::read(priv->fd, buf, len);
-    if (rlen <= 0) {
-        const ErrorDesc *desc = getErrorDesc(errno,
-            rwErrDescs, ARRAY_LEN(rwErrDescs));
-        throw HandleException(this, desc->err, desc->msg);
-        return 0;
+    IoResult result = tryRead(buf, len);
+    if (result.len == 0) {
+        throwIoResult(this, result);
     }
-    return static_cast<size_t>(rlen);
+    return result.len;
+}
+
+size_t Handle::writev(const IoVec *iov, size_t cnt) {
+    IoResult result = tryWritev(iov, cnt);
+    if (result.len == 0) {
+        throwIoResult(this, result);
+    }
+    return result.len;
+}
+
+size_t Handle::readv(const IoVec *iov, size_t cnt) {
+    IoResult result = tryReadv(iov, cnt);
+    if (result.len == 0) {
+        throwIoResult(this, result);
+    }
+    return result.len;
+}
+
+void Handle::writevAll(IoVec *iov, size_t cnt) {
+    size_t wlen = 0;
+    for (;;) {
+        // Skip the buffers written, and advance the one written partially.
+        while (cnt && wlen >= iov->len) {
+            wlen -= iov->len;
+            iov->len = 0;
+            iov++;
+            cnt--;
+        }
+        if (cnt == 0) {
+            break;
+        }
+        iov->base = static_cast<char *>(iov->base) + wlen;
+        iov->len -= wlen;
+        wlen = writev(iov, cnt);
+    }
+}
+
+/**
+ * @brief Get the file type of the handle, it's cached after the first call.
+*/
+static mode_t getFileType(Handle *handle, HandlePriv *priv) {
+    struct stat st;
+    if (priv->mode == 0) {
+        if (fstat(priv->fd, &st) < 0) {
+            throw HandleException(handle, common::ERR_ERR,
+                "failed to get the file type");
+        }
+        priv->mode = st.st_mode & S_IFMT;
+    }
+    return priv->mode;
+}
+
+/**
+ * @brief Copy a file with copy_file_range, fall back to sendfile
+ * if the files are not supported.
+*/
+static ssize_t copyFile(int src, int dst, u64 *offset, size_t len) {
+    // Shared by the threads, only a hint to skip copy_file_range().
+    static std::atomic<bool> unsupported(false);
+    loff_t off;
+    ssize_t ret;
+
+    if (!unsupported.load(std::memory_order_relaxed)) {
+        off = offset ? static_cast<loff_t>(*offset) : 0;
+        ret = copy_file_range(src, offset ? &off : nullptr,
+            dst, nullptr, len, 0);
+        if (ret >= 0) {
+            if (offset) {
+                *offset = static_cast<u64>(off);
+            }
+            return ret;
+        }
+        if (errno == ENOSYS) {
+            unsupported.store(true, std::memory_order_relaxed);
+        } else if (errno != EXDEV && errno != EINVAL &&
+            errno != EOPNOTSUPP) {
+            return ret;
+        }
+    }
+    off = offset ? static_cast<off_t>(*offset) : 0;
+    ret = sendfile(dst, src, offset ? &off : nullptr, len);
+    if (ret >= 0 && offset) {
+        *offset = static_cast<u64>(off);
+    }
+    return ret;
+}
+
+/**
+ * @brief Get the side of a splice() failed with EAGAIN which is not ready,
+ * the caller waits for it.
+*/
+static Handle *getBlockedSide(Handle *src, int srcFd, Handle *dst, int dstFd) {
+    struct pollfd fds[2];
+
+    fds[0].fd = srcFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = dstFd;
+    fds[1].events = POLLOUT;
+    fds[0].revents = fds[1].revents = 0;
+    if (::poll(fds, 2, 0) > 0 && fds[0].revents) {
+        return dst;
+    }
+    // The source may become ready just now, waiting for it returns at once.
+    return src;
+}
+
+size_t Handle::transferTo(Handle *dst, u64 *offset, size_t len) {
+    HandlePriv *dpriv;
+    ssize_t ret;
+
+    ASSERT(dst);
+    ASSERT(len);
+    dpriv = dst->priv;
+    if (getFileType(this, priv) == S_IFREG) {
+        if (getFileType(dst, dpriv) == S_IFREG) {
+            ret = copyFile(priv->fd, dpriv->fd, offset, len);
+        } else {
+            off_t off = offset ? static_cast<off_t>(*offset) : 0;
+            ret = sendfile(dpriv->fd, priv->fd, offset ? &off : nullptr, len);
+            if (ret >= 0 && offset) {
+                *offset = static_cast<u64>(off);
+            }
+        }
+        if (ret < 0) {
+            throwRwError(dst, ret);
+        }
+        return static_cast<size_t>(ret);
+    }
+
+    ASSERT(offset == nullptr);
+    // splice() needs a pipe on one side.
+    if (priv->mode == S_IFIFO || getFileType(dst, dpriv) == S_IFIFO) {
+        ret = splice(priv->fd, nullptr, dpriv->fd, nullptr, len,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret < 0) {
+            throwRwError(errno == EAGAIN ?
+                getBlockedSide(this, priv->fd, dst, dpriv->fd) : this, ret);
+        }
+        return static_cast<size_t>(ret);
+    }
+    if (priv->pipe[0] < 0 && pipe2(priv->pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        throw HandleException(this, common::ERR_MEM,
+            "failed to create a pipe");
+    }
+    if (priv->piped < len) {
+        ret = splice(priv->fd, nullptr, priv->pipe[1], nullptr,
+            len - priv->piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret > 0) {
+            priv->piped += ret;
+        } else if (priv->piped == 0) {
+            if (ret == 0) {
+                return 0;
+            }
+            throwRwError(this, ret);
+        }
+    }
+    ret = splice(priv->pipe[0], nullptr, dpriv->fd, nullptr,
+        priv->piped < len ? priv->piped : len,
+        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (ret < 0) {
+        throwRwError(dst, ret);
+    }
+    priv->piped -= ret;
+    return static_cast<size_t>(ret);
 }
 
 static int getOpenFlag(int mode) {
@@ -201,4 +495,532 @@ size_t FileHandle::seek(SeekMode mode, ssize_t len) {
     return static_cast<size_t>(ret);
 }
 
+size_t FileHandle::pread(void *buf, size_t len, u64 offset) {
+    ssize_t rlen;
+    rlen = ::pread(priv->fd, buf, len, static_cast<off_t>(offset));
+    if (rlen <= 0) {
+        throwRwError(this, rlen);
+        return 0;
+    }
+    return static_cast<size_t>(rlen);
+}
+
+size_t FileHandle::pwrite(const void *buf, size_t len, u64 offset) {
+    ssize_t wlen;
+    wlen = ::pwrite(priv->fd, buf, len, static_cast<off_t>(offset));
+    if (wlen <= 0) {
+        throwRwError(this, wlen);
+        return 0;
+    }
+    return static_cast<size_t>(wlen);
+}
+
+/**
+ * @brief Throw the error of a failed socket call.
+*/
+static void throwSockError(Handle *handle, int err) {
+    const ErrorDesc *desc = getErrorDesc(err,
+        sockErrDescs, ARRAY_LEN(sockErrDescs));
+    if (desc == nullptr) {
+        throw HandleException(handle, common::ERR_ERR);
+    }
+    throw HandleException(handle, desc->err, desc->msg);
+}
+
+/**
+ * @brief Get the address family of the socket, it's cached after the first
+ * call.
+*/
+static int getSockFamily(Handle *handle, HandlePriv *priv) {
+    if (priv->family == 0) {
+        socklen_t len = sizeof(priv->family);
+        if (getsockopt(priv->fd, SOL_SOCKET, SO_DOMAIN,
+            &priv->family, &len) < 0) {
+            throwSockError(handle, errno);
+        }
+    }
+    return priv->family;
+}
+
+/**
+ * @brief Fill the socket address of the address family of the socket.
+ * @details An IPv4 address is mapped to an IPv6 address
+ * for an IPv6 socket.
+ *
+ * @param hasIp is false for the any address
+ * @return the length of the socket address.
+*/
+static socklen_t getSockAddr(Handle *handle, HandlePriv *priv,
+    u32 ip, bool hasIp, u16 port, struct sockaddr_storage *ss) {
+    int family = getSockFamily(handle, priv);
+
+    memset(ss, 0, sizeof(*ss));
+    if (family == AF_INET) {
+        struct sockaddr_in *sin = reinterpret_cast<struct sockaddr_in *>(ss);
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        sin->sin_addr.s_addr = htonl(hasIp ? ip : INADDR_ANY);
+        return sizeof(*sin);
+    } else if (family == AF_INET6) {
+        struct sockaddr_in6 *sin6 =
+            reinterpret_cast<struct sockaddr_in6 *>(ss);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(port);
+        if (hasIp) {
+            // ::ffff:a.b.c.d
+            sin6->sin6_addr.s6_addr[10] = 0xff;
+            sin6->sin6_addr.s6_addr[11] = 0xff;
+            ip = htonl(ip);
+            memcpy(sin6->sin6_addr.s6_addr + 12, &ip, sizeof(ip));
+        } else {
+            sin6->sin6_addr = in6addr_any;
+        }
+        return sizeof(*sin6);
+    }
+    throw HandleException(handle, common::ERR_INVAL_ARG,
+        "the address family is not supported");
+    return 0;
+}
+
+static socklen_t getSockAddr(Handle *handle, HandlePriv *priv,
+    const net::Addr *addr, u16 port, struct sockaddr_storage *ss) {
+    u32 ip = INADDR_ANY;
+
+    if (addr) {
+        if (addr->getType() != net::Addr::IPV4) {
+            throw HandleException(handle, common::ERR_INVAL_ARG,
+                "the address type is not supported");
+        }
+        ip = static_cast<const net::Addr4 *>(addr)->getIp();
+    }
+    return getSockAddr(handle, priv, ip, addr != nullptr, port, ss);
+}
+
+/**
+ * @brief Get the IPv4 address and the port of a socket address.
+ *
+ * @return false if it's not an IPv4 address.
+*/
+static bool parseSockAddr(const struct sockaddr_storage *ss,
+    u32 *ip, u16 *port) {
+    if (ss->ss_family == AF_INET) {
+        const struct sockaddr_in *sin =
+            reinterpret_cast<const struct sockaddr_in *>(ss);
+        *ip = ntohl(sin->sin_addr.s_addr);
+        *port = ntohs(sin->sin_port);
+        return true;
+    } else if (ss->ss_family == AF_INET6) {
+        const struct sockaddr_in6 *sin6 =
+            reinterpret_cast<const struct sockaddr_in6 *>(ss);
+        *port = ntohs(sin6->sin6_port);
+        if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+            memcpy(ip, sin6->sin6_addr.s6_addr + 12, sizeof(*ip));
+            *ip = ntohl(*ip);
+            return true;
+        }
+    }
+    return false;
+}
+
+SocketHandle::SocketHandle(DomainType domain, SockType sock) {
+    int family;
+    int type;
+
+    switch (domain) {
+    case D_UNIX:
+        family = AF_UNIX;
+        break;
+    case D_IPV6:
+        family = AF_INET6;
+        break;
+    default:
+        family = AF_INET;
+        break;
+    }
+    switch (sock) {
+    case S_UDP:
+        type = SOCK_DGRAM;
+        break;
+    case S_RAM:
+        type = SOCK_RAW;
+        break;
+    default:
+        type = SOCK_STREAM;
+        break;
+    }
+    int fd = socket(family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throwSockError(this, errno);
+        return;
+    }
+    priv->fd = fd;
+    priv->family = family;
+}
+
+void SocketHandle::bind(const net::Addr *addr, u16 port) {
+    struct sockaddr_storage ss;
+    socklen_t len = getSockAddr(this, priv, addr, port, &ss);
+    if (::bind(priv->fd, reinterpret_cast<struct sockaddr *>(&ss), len) < 0) {
+        throwSockError(this, errno);
+    }
+}
+
+void SocketHandle::listen(int backlog) {
+    if (::listen(priv->fd, backlog) < 0) {
+        throwSockError(this, errno);
+    }
+}
+
+SocketHandle *SocketHandle::accept(net::Addr4 *addr, u16 *port) {
+    struct sockaddr_storage ss;
+    socklen_t len;
+    int fd;
+
+    for (;;) {
+        len = sizeof(ss);
+        fd = accept4(priv->fd, reinterpret_cast<struct sockaddr *>(&ss),
+            &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0) {
+            break;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return nullptr;
+        }
+        // The connection was aborted before it's accepted, try the next.
+        if (errno != ECONNABORTED && errno != EINTR) {
+            throwSockError(this, errno);
+        }
+    }
+
+    SocketHandle *handle = new SocketHandle;
+    handle->priv->fd = fd;
+    handle->priv->mode = S_IFSOCK;
+    handle->priv->family = priv->family;
+    u32 ip;
+    u16 peerPort;
+    if (parseSockAddr(&ss, &ip, &peerPort)) {
+        if (addr) {
+            addr->setIp(ip);
+        }
+        if (port) {
+            *port = peerPort;
+        }
+    }
+    return handle;
+}
+
+size_t SocketHandle::accept(SocketHandle **handles, size_t num) {
+    size_t i;
+
+    ASSERT(handles);
+    for (i = 0; i < num; i++) {
+        try {
+            handles[i] = accept();
+        } catch (HandleException &e) {
+            // Return the accepted, the error is thrown by the next call.
+            if (i) {
+                break;
+            }
+            throw;
+        }
+        if (handles[i] == nullptr) {
+            break;
+        }
+    }
+    return i;
+}
+
+bool SocketHandle::connect(const net::Addr *addr, u16 port) {
+    struct sockaddr_storage ss;
+    socklen_t len;
+
+    ASSERT(addr);
+    len = getSockAddr(this, priv, addr, port, &ss);
+    if (::connect(priv->fd, reinterpret_cast<struct sockaddr *>(&ss),
+        len) == 0) {
+        return true;
+    }
+    if (errno != EINPROGRESS) {
+        throwSockError(this, errno);
+    }
+    return false;
+}
+
+void SocketHandle::finishConnect() {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(priv->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        err = errno;
+    }
+    if (err) {
+        throwSockError(this, err);
+    }
+}
+
+/**
+ * @brief Get the level and the name of a socket option.
+*/
+static void getSockOpt(SocketHandle *handle, SocketHandle::Option opt,
+    int *level, int *name) {
+    *level = SOL_SOCKET;
+    switch (opt) {
+    case SocketHandle::O_REUSE_ADDR:
+        *name = SO_REUSEADDR;
+        break;
+    case SocketHandle::O_REUSE_PORT:
+        *name = SO_REUSEPORT;
+        break;
+    case SocketHandle::O_NO_DELAY:
+        *level = IPPROTO_TCP;
+        *name = TCP_NODELAY;
+        break;
+    case SocketHandle::O_KEEP_ALIVE:
+        *name = SO_KEEPALIVE;
+        break;
+    case SocketHandle::O_SEND_BUF:
+        *name = SO_SNDBUF;
+        break;
+    case SocketHandle::O_RECV_BUF:
+        *name = SO_RCVBUF;
+        break;
+    case SocketHandle::O_UDP_SEGMENT:
+        *level = SOL_UDP;
+        *name = UDP_SEGMENT;
+        break;
+    case SocketHandle::O_UDP_GRO:
+        *level = SOL_UDP;
+        *name = UDP_GRO;
+        break;
+    default:
+        throw HandleException(handle, common::ERR_INVAL_ARG,
+            "unknown socket option");
+    }
+}
+
+void SocketHandle::setOption(Option opt, int value) {
+    int level;
+    int name;
+
+    getSockOpt(this, opt, &level, &name);
+    if (setsockopt(priv->fd, level, name, &value, sizeof(value)) < 0) {
+        throwSockError(this, errno);
+    }
+}
+
+int SocketHandle::getOption(Option opt) {
+    int level;
+    int name;
+    int value = 0;
+    socklen_t len = sizeof(value);
+
+    getSockOpt(this, opt, &level, &name);
+    if (getsockopt(priv->fd, level, name, &value, &len) < 0) {
+        throwSockError(this, errno);
+    }
+    return value;
+}
+
+u16 SocketHandle::getLocalPort() {
+    struct sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+    u32 ip;
+    u16 port = 0;
+
+    if (getsockname(priv->fd, reinterpret_cast<struct sockaddr *>(&ss),
+        &len) < 0) {
+        throwSockError(this, errno);
+    }
+    // The port is got even if it's not an IPv4 address.
+    parseSockAddr(&ss, &ip, &port);
+    return port;
+}
+
+size_t SocketHandle::recvBatch(Datagram *msgs, size_t num) {
+    struct mmsghdr hdrs[PFM_SOCKET_BATCH_MAX];
+    struct iovec iovs[PFM_SOCKET_BATCH_MAX];
+    struct sockaddr_storage addrs[PFM_SOCKET_BATCH_MAX];
+    // The GRO segment size.
+    char ctrls[PFM_SOCKET_BATCH_MAX][CMSG_SPACE(sizeof(int))];
+    int ret;
+
+    ASSERT(msgs);
+    if (num > PFM_SOCKET_BATCH_MAX) {
+        num = PFM_SOCKET_BATCH_MAX;
+    }
+    memset(hdrs, 0, sizeof(hdrs[0]) * num);
+    for (size_t i = 0; i < num; i++) {
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = msgs[i].len;
+        hdrs[i].msg_hdr.msg_iov = iovs + i;
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        hdrs[i].msg_hdr.msg_name = addrs + i;
+        hdrs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        hdrs[i].msg_hdr.msg_control = ctrls[i];
+        hdrs[i].msg_hdr.msg_controllen = sizeof(ctrls[i]);
+    }
+    do {
+        ret = recvmmsg(priv->fd, hdrs, num, 0, nullptr);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        throwSockError(this, errno);
+    }
+
+    for (int i = 0; i < ret; i++) {
+        Datagram *msg = msgs + i;
+        msg->len = hdrs[i].msg_len;
+        msg->ip = 0;
+        msg->port = 0;
+        msg->segSize = 0;
+        if (hdrs[i].msg_hdr.msg_namelen) {
+            parseSockAddr(addrs + i, &msg->ip, &msg->port);
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdrs[i].msg_hdr); cmsg;
+            cmsg = CMSG_NXTHDR(&hdrs[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int size;
+                memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                msg->segSize = static_cast<u16>(size);
+            }
+        }
+    }
+    return static_cast<size_t>(ret);
+}
+
+size_t SocketHandle::sendBatch(const Datagram *msgs, size_t num) {
+    struct mmsghdr hdrs[PFM_SOCKET_BATCH_MAX];
+    struct iovec iovs[PFM_SOCKET_BATCH_MAX];
+    struct sockaddr_storage addrs[PFM_SOCKET_BATCH_MAX];
+    // The GSO segment size.
+    char ctrls[PFM_SOCKET_BATCH_MAX][CMSG_SPACE(sizeof(u16))];
+    int ret;
+
+    ASSERT(msgs);
+    if (num > PFM_SOCKET_BATCH_MAX) {
+        num = PFM_SOCKET_BATCH_MAX;
+    }
+    memset(hdrs, 0, sizeof(hdrs[0]) * num);
+    for (size_t i = 0; i < num; i++) {
+        const Datagram *msg = msgs + i;
+        iovs[i].iov_base = msg->buf;
+        iovs[i].iov_len = msg->len;
+        hdrs[i].msg_hdr.msg_iov = iovs + i;
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        if (msg->port) {
+            hdrs[i].msg_hdr.msg_name = addrs + i;
+            hdrs[i].msg_hdr.msg_namelen = getSockAddr(this, priv,
+                msg->ip, true, msg->port, addrs + i);
+        }
+        if (msg->segSize) {
+            memset(ctrls[i], 0, sizeof(ctrls[i]));
+            hdrs[i].msg_hdr.msg_control = ctrls[i];
+            hdrs[i].msg_hdr.msg_controllen = sizeof(ctrls[i]);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdrs[i].msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(u16));
+            memcpy(CMSG_DATA(cmsg), &msg->segSize, sizeof(u16));
+        }
+    }
+    do {
+        ret = sendmmsg(priv->fd, hdrs, num, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        throwSockError(this, errno);
+    }
+    return static_cast<size_t>(ret);
+}
+
+void SocketHandle::setZeroCopy(size_t threshold) {
+    int on = 1;
+
+    if (threshold && priv->zcThreshold == 0 && setsockopt(priv->fd,
+        SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+        throwSockError(this, errno);
+    }
+    // SO_ZEROCOPY can't be cleared, the sends just don't ask for it.
+    priv->zcThreshold = threshold;
+}
+
+size_t SocketHandle::sendZeroCopy(const void *buf, size_t len, u32 *id) {
+    ssize_t ret;
+
+    ASSERT(id);
+    *id = ZC_COPIED;
+    if (priv->zcThreshold && len >= priv->zcThreshold) {
+        do {
+            ret = send(priv->fd, buf, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        } while (ret < 0 && errno == EINTR);
+        if (ret >= 0) {
+            *id = priv->zcNext++;
+            return static_cast<size_t>(ret);
+        }
+        // Out of the memory to pin the pages, copy it.
+        if (errno != ENOBUFS) {
+            throwSockError(this, errno);
+        }
+    }
+    do {
+        ret = send(priv->fd, buf, len, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        throwSockError(this, errno);
+    }
+    return static_cast<size_t>(ret);
+}
+
+bool SocketHandle::readZeroCopy(u32 *first, u32 *last, bool *copied) {
+    char ctrl[CMSG_SPACE(sizeof(struct sock_extended_err) +
+        sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    ASSERT(first);
+    ASSERT(last);
+    // Skip the messages which are not completions, such as ICMP errors.
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        if (recvmsg(priv->fd, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            }
+            throwSockError(this, errno);
+        }
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+            cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP &&
+                cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == SOL_IPV6 &&
+                cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            *first = err.ee_info;
+            *last = err.ee_data;
+            if (err.ee_errno) {
+                throw HandleException(this, getRwError(err.ee_errno),
+                    "the zero-copy sends failed");
+            }
+            if (copied) {
+                *copied = err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+            }
+            return true;
+        }
+    }
+}
+
 }  // namespace platform
@@ -30,6 +30,7 @@
 #define PFM_SUPPORT_C_LIBRARY
 #define PFM_SUPPORT_FILE_HANDLE
 #define PFM_SUPPORT_SOCKET_HANDLE
+#define PFM_SUPPORT_MAPPED_FILE
 
 #ifdef DEBUG
 /// Enable debug.
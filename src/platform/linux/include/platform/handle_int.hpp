@@ -30,9 +30,25 @@ namespace platform {
 
 class HandlePriv {
  public:
-    HandlePriv(): fd(-1) {}
+    HandlePriv(): fd(-1), mode(0), piped(0), family(0),
+        zcThreshold(0), zcNext(0) {
+        pipe[0] = pipe[1] = -1;
+    }
 
     int fd;
+    mode_t mode;    ///< file type of fd, 0 if not known yet
+    int pipe[2];    ///< pipe used to splice from the handle
+    size_t piped;   ///< bytes spliced into the pipe, not written out
+    int family;     ///< address family of the socket, 0 if not known yet
+    size_t zcThreshold;     ///< the minimum size of zero-copy, 0 if disabled
+    u32 zcNext;     ///< the id of the next zero-copy send
 };
 
+/**
+ * @brief Get the error code of a failed read or write.
+ *
+ * @param err is the errno of the system call
+*/
+common::ErrorCode getRwError(int err);
+
 }  // namespace platform
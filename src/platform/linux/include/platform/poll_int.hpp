@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#pragma once
+
+#include <sys/epoll.h>
+
+/**
+ * @file poll_int.hpp
+ * @brief Platform Linux Poll backend interfaces
+*/
+
+namespace platform {
+
+/**
+ * @brief The backend of the poll, it waits for the events of file descriptors.
+ * @details The interfaces follow epoll, the events are epoll events and flags.
+*/
+class PollBackend {
+ public:
+    virtual ~PollBackend() {}
+
+    /**
+     * @brief Add, modify or delete a file descriptor, see epoll_ctl().
+     *
+     * @param op is EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL
+     * @param fd is the file descriptor
+     * @param event is the events and the data, nullptr for EPOLL_CTL_DEL
+     * @return 0 on success, -1 on error and errno is set
+    */
+    virtual int ctl(int op, int fd, struct epoll_event *event) = 0;
+
+    /**
+     * @brief Wait for the events, see epoll_wait().
+     *
+     * @param events is the buffer to store the events
+     * @param max is the max number of the events
+     * @param timeout is the max wait time in milliseconds(-1 == infinite)
+     * @return the number of the events, -1 on error and errno is set
+    */
+    virtual int wait(struct epoll_event *events, int max, int timeout) = 0;
+};
+
+/**
+ * @brief Create a backend driven by io_uring.
+ *
+ * @return the backend, nullptr if io_uring is unavailable.
+*/
+PollBackend *createUringBackend();
+
+}  // namespace platform
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <common/assert.hpp>
+#include <platform/mapped_file.hpp>
+#include <platform/error.hpp>
+
+namespace platform {
+
+static const ErrorDesc mapErrDescs[] = {
+    {EACCES, common::ERR_PERM, "the access to the file is not allowed"},
+    {ENOENT, common::ERR_NOENT, "the file does not exist"},
+    {ENOMEM, common::ERR_MEM, "no memory to map the file"},
+    {EINVAL, common::ERR_INVAL_ARG, "invalid argument to map the file"},
+};
+
+class MappedFilePriv {
+ public:
+    MappedFilePriv(): fd(-1), flags(0), data(nullptr), size(0),
+        advice(MappedFile::A_NORMAL) {}
+
+    int fd;
+    int flags;
+    void *data;
+    size_t size;
+    MappedFile::Advice advice;  ///< the hint for the whole file
+};
+
+/**
+ * @brief Throw the error of a failed system call.
+*/
+static void throwMapError(MappedFile *file) {
+    const ErrorDesc *desc = getErrorDesc(errno,
+        mapErrDescs, ARRAY_LEN(mapErrDescs));
+    if (desc == nullptr) {
+        throw MappedFileException(file, common::ERR_ERR);
+    }
+    throw MappedFileException(file, desc->err, desc->msg);
+}
+
+static int getAdvice(MappedFile::Advice advice) {
+    switch (advice) {
+    case MappedFile::A_SEQUENTIAL:
+        return MADV_SEQUENTIAL;
+    case MappedFile::A_RANDOM:
+        return MADV_RANDOM;
+    case MappedFile::A_WILLNEED:
+        return MADV_WILLNEED;
+    case MappedFile::A_DONTNEED:
+        return MADV_DONTNEED;
+    default:
+        return MADV_NORMAL;
+    }
+}
+
+/**
+ * @brief Apply the flags and the hint to the new mapping.
+*/
+static void setupMapping(MappedFilePriv *priv) {
+#ifdef MADV_HUGEPAGE
+    if (priv->flags & MappedFile::F_HUGEPAGE) {
+        // Only a hint, not all the file systems support it.
+        madvise(priv->data, priv->size, MADV_HUGEPAGE);
+    }
+#endif
+    if (priv->advice != MappedFile::A_NORMAL) {
+        madvise(priv->data, priv->size, getAdvice(priv->advice));
+    }
+}
+
+/**
+ * @brief Pre-fault the pages of the mapping from the offset to the end,
+ * for F_POPULATE after the mapping grows.
+*/
+static void populate(MappedFilePriv *priv, size_t offset) {
+    static size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset & ~(pageSize - 1);
+    const char *data = static_cast<const char *>(priv->data);
+
+#ifdef MADV_POPULATE_READ
+    if (madvise(static_cast<char *>(priv->data) + start,
+        priv->size - start, MADV_POPULATE_READ) == 0) {
+        return;
+    }
+#endif
+    // Linux before 5.14, touch the pages.
+    for (size_t i = start; i < priv->size; i += pageSize) {
+        static_cast<void>(*static_cast<const volatile char *>(data + i));
+    }
+}
+
+MappedFile::MappedFile(const char *path, int flags): priv(new MappedFilePriv) {
+    struct stat st;
+    int mapFlags = MAP_SHARED;
+
+    ASSERT(path);
+    priv->flags = flags;
+    priv->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (priv->fd < 0) {
+        delete priv;
+        throwMapError(this);
+    }
+    if (fstat(priv->fd, &st) < 0) {
+        goto err;
+    }
+    priv->size = static_cast<size_t>(st.st_size);
+    if (priv->size == 0) {
+        return;
+    }
+    if (flags & F_POPULATE) {
+        mapFlags |= MAP_POPULATE;
+    }
+    priv->data = mmap(nullptr, priv->size, PROT_READ, mapFlags, priv->fd, 0);
+    if (priv->data == MAP_FAILED) {
+        priv->data = nullptr;
+        goto err;
+    }
+    setupMapping(priv);
+    return;
+err:
+    int err = errno;
+    close(priv->fd);
+    delete priv;
+    errno = err;
+    throwMapError(this);
+}
+
+MappedFile::~MappedFile() {
+    if (priv->data) {
+        munmap(priv->data, priv->size);
+    }
+    close(priv->fd);
+    delete priv;
+}
+
+const void *MappedFile::getData() const {
+    return priv->data;
+}
+
+size_t MappedFile::getSize() const {
+    return priv->size;
+}
+
+const void *MappedFile::getRange(size_t offset, size_t len) const {
+    if (offset > priv->size || len > priv->size - offset) {
+        throw MappedFileException(const_cast<MappedFile *>(this),
+            common::ERR_OVER_RANGE, "the range is out of the file");
+    }
+    return static_cast<const char *>(priv->data) + offset;
+}
+
+void MappedFile::advise(Advice advice, size_t offset, size_t len) {
+    static size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start;
+
+    if (offset > priv->size || len > priv->size - offset) {
+        throw MappedFileException(this, common::ERR_OVER_RANGE,
+            "the range is out of the file");
+    }
+    if (len == 0) {
+        len = priv->size - offset;
+        if (offset == 0) {
+            priv->advice = advice;
+        }
+    }
+    if (len == 0) {
+        return;
+    }
+    // madvise() needs the start aligned to a page.
+    start = offset & ~(pageSize - 1);
+    if (madvise(static_cast<char *>(priv->data) + start,
+        len + offset - start, getAdvice(advice)) < 0) {
+        throwMapError(this);
+    }
+}
+
+bool MappedFile::remap() {
+    struct stat st;
+    size_t size;
+    size_t oldSize = priv->size;
+    void *data;
+
+    if (fstat(priv->fd, &st) < 0) {
+        throwMapError(this);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size == priv->size) {
+        return false;
+    }
+    if (size == 0) {
+        data = nullptr;
+        munmap(priv->data, priv->size);
+    } else if (priv->data == nullptr) {
+        data = mmap(nullptr, size, PROT_READ, (priv->flags & F_POPULATE) ?
+            MAP_SHARED | MAP_POPULATE : MAP_SHARED, priv->fd, 0);
+    } else {
+        data = mremap(priv->data, priv->size, size, MREMAP_MAYMOVE);
+    }
+    if (data == MAP_FAILED) {
+        throwMapError(this);
+    }
+    priv->data = data;
+    priv->size = size;
+    if (data) {
+        setupMapping(priv);
+        // mremap() doesn't populate the pages added to the mapping.
+        if ((priv->flags & F_POPULATE) && oldSize && size > oldSize) {
+            populate(priv, oldSize);
+        }
+    }
+    return true;
+}
+
+}  // namespace platform
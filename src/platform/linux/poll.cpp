@@ -21,20 +21,66 @@
 */
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <cerrno>
-#include <map>
+#include <sched.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <exception>
+#include <vector>
 #include <common/assert.hpp>
 #include <platform/poll.hpp>
-#include <platform/lock.hpp>
+#include <platform/clock.hpp>
 #include <platform/handle_int.hpp>
+#include <platform/poll_int.hpp>
 #include <platform/error.hpp>
 
 #define PFM_EPOLL_FD_MAX 1024
 #define PFM_EPOLL_MAX_LISTEN 64
+/// The max number of events the event array grows to.
+#define PFM_EPOLL_MAX_LISTEN_LIMIT 4096
+
+/// The max number of file descriptors that can be watched by a poll.
+#define PFM_POLL_STATE_MAX (1 << 20)
+/// The number of handle states in a page of the state table.
+#define PFM_POLL_STATE_PAGE_SIZE 256
+/// The number of signals read from the signalfd at a time.
+#define PFM_POLL_SIGNAL_BATCH 16
 
 namespace platform {
 
-class HandleState;
+/// The number of events in enum Poll::Event.
+static const int POLL_EVENT_NUM = Poll::EV_ERR + 1;
+
+/// The epoll flags stored with the events of a handle state.
+static const u32 POLL_EPOLL_FLAGS =
+    EPOLLET | EPOLLONESHOT | EPOLLRDHUP | EPOLLEXCLUSIVE;
+
+/// The epoll data of the wakeup eventfd, no fd can be packed into it.
+static const u64 POLL_DATA_WAKEUP = ~static_cast<u64>(0);
+/// The epoll data of the signalfd.
+static const u64 POLL_DATA_SIGNAL = ~static_cast<u64>(1);
+
+/// The handle state is in the changelist.
+static const u32 POLL_CHANGE_QUEUED = (1 << 0);
+/// The one-shot handle state must be enabled again.
+static const u32 POLL_CHANGE_REARM = (1 << 1);
+/// The generation of the handle state is changed.
+static const u32 POLL_CHANGE_GEN = (1 << 2);
+
+/// Priority classes, dispatched from the high to the low.
+static const u32 POLL_PRIO_HIGH = 0;
+static const u32 POLL_PRIO_NORMAL = 1;
+static const u32 POLL_PRIO_LOW = 2;
+static const u32 POLL_PRIO_NUM = 3;
+
+/// The default number of EV_READ callbacks of a handle in a polling().
+static const u32 POLL_READ_BUDGET = 1;
 
 static const ErrorDesc epollCtlCommonErrDescs[] = {
     {EBADF, common::ERR_INVAL_ARG, "the handle is invalid"},
@@ -53,59 +99,923 @@ static const ErrorDesc epollCtlModErrDescs[] = {
 };
 
 static uint32_t getEpollEvent(Poll::Event event);
+static uint32_t getEpollFlags(int flags);
 static void epollCtlExcept(int epopt, int err, Poll *poll);
-static void callPollEvent(HandleState *state, Poll::Event event);
 
-class PollCallback {
+/**
+ * @brief Get the monotonic time in microseconds.
+*/
+static inline u64 getMonotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<u64>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief The state of a file descriptor in the poll.
+ * @details The states are stored in a table indexed by the file descriptor,
+ * the callbacks are stored inline, one slot per event.
+*/
+class HandleState {
+ public:
+    HandleState(): handle(nullptr), gen(0), events(0), kevents(0), change(0),
+        prio(POLL_PRIO_NORMAL), iter(0), reads(0), ready(false) {}
+
+    Handle *handle;     ///< the handle, nullptr if the state is unused
+    u32 gen;            ///< generation, increased each time the state is used
+    u32 events;         ///< epoll events and flags of the added events
+    u32 kevents;        ///< epoll events and flags registered to the backend
+    u32 change;         ///< the pending change, POLL_CHANGE_XXX
+    u32 prio;           ///< the priority class, POLL_PRIO_XXX
+    u32 iter;           ///< the iteration of polling() counting the reads
+    u32 reads;          ///< EV_READ callbacks called in the iteration
+    bool ready;         ///< EV_READ is called again, see Poll::setReady()
+    Poll::Callback cbs[POLL_EVENT_NUM];
+};
+
+/**
+ * @brief A ready event to dispatch.
+*/
+class PollEvent {
  public:
-    explicit PollCallback(Poll::cb_t cb, void *arg): cb(cb), arg(arg) {}
-    Poll::cb_t cb;
+    PollEvent(u64 data, u32 events): data(data), events(events) {}
+    u64 data;           ///< epoll data of the handle state
+    u32 events;         ///< epoll events, 0 for a carried EV_READ
+};
+
+/**
+ * @brief Pack the fd and the generation of its state into epoll data,
+ * used to drop the events from a stale state.
+*/
+static inline u64 packEpollData(int fd, u32 gen) {
+    return (static_cast<u64>(gen) << 32) | static_cast<u32>(fd);
+}
+
+/**
+ * @brief The default backend driven by epoll.
+*/
+class EpollBackend: public PollBackend {
+ public:
+    explicit EpollBackend(int epfd): epfd(epfd) {}
+
+    ~EpollBackend() {
+        close(epfd);
+    }
+
+    int ctl(int op, int fd, struct epoll_event *event) {
+        return epoll_ctl(epfd, op, fd, event);
+    }
+
+    int wait(struct epoll_event *events, int max, int timeout) {
+        return epoll_wait(epfd, events, max, timeout);
+    }
+
+ private:
+    int epfd;
+};
+
+class PollSignal {
+ public:
+    PollSignal(): cb(nullptr), arg(nullptr) {}
+    Poll::signal_cb_t cb;
     void *arg;
 };
 
-class HandleState {
+/**
+ * @brief A task posted to the poll.
+*/
+class PollTask {
  public:
-    explicit HandleState(Poll::Event event, Handle *handle,
-        Poll::cb_t cb, void *arg = nullptr): handle(handle) {
-        cbMap.insert({event, new PollCallback(cb, arg)});
+    explicit PollTask(Poll::task_t fn, void *arg):
+        fn(fn), arg(arg), next(nullptr) {}
+    Poll::task_t fn;
+    void *arg;
+    PollTask *next;
+};
+
+/**
+ * @brief Get the id of the calling thread, 0 is never used.
+*/
+static u64 getThreadId() {
+    static std::atomic<u64> nextId(1);
+    static thread_local u64 id = 0;
+    if (!id) {
+        id = nextId.fetch_add(1, std::memory_order_relaxed);
     }
+    return id;
+}
 
-    ~HandleState() {
-        for (auto i : cbMap) {
-            delete i.second;
+/**
+ * @brief A registration request from a thread not owning the poll.
+ * @details The requests are pushed to a lock-free stack and applied by
+ * the owner. A waited request lives on the stack of the submitting thread,
+ * it's woken up by a futex once the request is applied.
+*/
+class PollRequest {
+ public:
+    enum Type {
+        R_ADD,
+        R_MOD,
+        R_DEL,
+        R_REARM,
+    };
+
+    PollRequest(Type type, int fd, Handle *handle, Poll::Event event,
+        Poll::Callback cb, int flags, bool waited):
+        type(type), fd(fd), handle(handle), event(event), cb(std::move(cb)),
+        flags(flags), waited(waited), done(0), next(nullptr) {}
+
+    /**
+     * @brief Wait until the request is applied.
+    */
+    void wait() {
+        while (!done.load(std::memory_order_acquire)) {
+            syscall(SYS_futex, reinterpret_cast<int *>(&done),
+                FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
         }
     }
 
-    PollCallback *findPollCallback(Poll::Event event) {
-        auto it = cbMap.find(event);
-        if (it == cbMap.end()) {
-            return nullptr;
-        } else {
-            return it->second;
-        }
+    /**
+     * @brief Wake up the waiting thread, the request must not be used after.
+    */
+    void notify() {
+        int *addr = reinterpret_cast<int *>(&done);
+        done.store(1, std::memory_order_release);
+        syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
     }
 
+    Type type;
+    int fd;
     Handle *handle;
-    std::map<Poll::Event, PollCallback *> cbMap;
+    Poll::Event event;
+    Poll::Callback cb;
+    int flags;
+    bool waited;
+    std::exception_ptr error;   ///< the error of a waited request
+    std::atomic<int> done;      ///< futex word, nonzero once applied
+    PollRequest *next;
 };
 
+/**
+ * @brief The handle states are owned by one thread at a time.
+ * @details The thread doing polling() owns the poll until polling() returns,
+ * other threads own it only for a registration when nobody is polling.
+ * A thread failing to own the poll submits a request to the owner instead.
+ *
+ * The states are never freed, a state reused by another fd is told apart
+ * by its generation. A callback is removed from another thread only
+ * at a quiescent point of the owner, between two callbacks, so del()
+ * returning guarantees the callback is not running and will not run.
+*/
 class PollPriv {
  public:
-    PollPriv(): epfd(-1), mutex(Lock(Lock::LOCK_MUTEX)), isPolling(false) {}
+    explicit PollPriv(Poll *poll): poll(poll), owner(0), isPolling(false),
+        backend(nullptr), backendType(Poll::B_DEFAULT), evfd(-1), sigfd(-1),
+        signals(nullptr),
+        handleNum(0), prioNum(0), iter(0), readBudget(POLL_READ_BUDGET),
+        ctlCalls(0), ctlSaved(0), busyPollUs(0), spinWaits(0),
+        spinHits(0), blockWaits(0), runState(nullptr),
+        runEvent(0), runReplaced(false), requests(nullptr),
+        tasks(nullptr), woken(false),
+        timers(Clock::Instance().getTotalMs()) {
+        pages = new HandleState *[PFM_POLL_STATE_MAX /
+            PFM_POLL_STATE_PAGE_SIZE]();
+        sigemptyset(&sigmask);
+    }
 
-    bool isPolling;
-    int epfd;
+    ~PollPriv() {
+        PollRequest *req = requests.load();
+        while (req) {
+            PollRequest *next = req->next;
+            if (!req->waited) {
+                delete req;
+            }
+            req = next;
+        }
+        PollTask *task = tasks.load();
+        while (task) {
+            PollTask *next = task->next;
+            delete task;
+            task = next;
+        }
+        for (int i = 0; i < PFM_POLL_STATE_MAX /
+            PFM_POLL_STATE_PAGE_SIZE; i++) {
+            delete [] pages[i];
+        }
+        delete [] pages;
+        delete [] signals;
+        if (sigfd >= 0) {
+            close(sigfd);
+        }
+        delete backend;
+    }
+
+    /**
+     * @brief Find the handle state of the file descriptor.
+     *
+     * @return the handle state, nullptr if the page is not allocated.
+    */
+    HandleState *findState(int fd) const {
+        if (fd < 0 || fd >= PFM_POLL_STATE_MAX) {
+            return nullptr;
+        }
+        HandleState *page = pages[fd / PFM_POLL_STATE_PAGE_SIZE];
+        if (!page) {
+            return nullptr;
+        }
+        return page + fd % PFM_POLL_STATE_PAGE_SIZE;
+    }
+
+    /**
+     * @brief Get the handle state of the file descriptor,
+     * allocate the page if it's not allocated.
+     *
+     * @return the handle state, nullptr if the fd is out of range.
+    */
+    HandleState *getState(int fd) {
+        if (fd < 0 || fd >= PFM_POLL_STATE_MAX) {
+            return nullptr;
+        }
+        HandleState *&page = pages[fd / PFM_POLL_STATE_PAGE_SIZE];
+        if (!page) {
+            page = new HandleState[PFM_POLL_STATE_PAGE_SIZE];
+        }
+        return page + fd % PFM_POLL_STATE_PAGE_SIZE;
+    }
+
+    /**
+     * @brief Try to own the poll in the calling thread.
+     *
+     * @param acquired is set to true if the poll is newly owned,
+     * it must be released by release().
+     * @return true if the calling thread owns the poll.
+    */
+    bool tryAcquire(bool *acquired) {
+        u64 self = getThreadId();
+        u64 expected = 0;
+
+        *acquired = false;
+        if (owner.load() == self) {
+            return true;
+        }
+        if (owner.compare_exchange_strong(expected, self)) {
+            *acquired = true;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Release the poll owned by tryAcquire().
+    */
+    void release() {
+        owner.store(0);
+        // A request submitted before the release must not be left behind.
+        while (requests.load()) {
+            u64 expected = 0;
+            if (!owner.compare_exchange_strong(expected, getThreadId())) {
+                break;
+            }
+            runRequests();
+            owner.store(0);
+        }
+    }
+
+    /**
+     * @brief Submit a request to the owner of the poll.
+     * @note The request is applied before it returns if nobody owns the poll.
+    */
+    void submit(PollRequest *req) {
+        PollRequest *head = requests.load(std::memory_order_relaxed);
+        bool acquired;
+
+        do {
+            req->next = head;
+        } while (!requests.compare_exchange_weak(head, req));
+        if (tryAcquire(&acquired)) {
+            runRequests();
+            if (acquired) {
+                release();
+            }
+            return;
+        }
+        // The owner may be sleeping in the backend.
+        poll->wakeup();
+    }
+
+    /**
+     * @brief Apply the submitted requests in submitted order.
+    */
+    void runRequests() {
+        PollRequest *req = requests.exchange(nullptr);
+        PollRequest *prev = nullptr;
+        // The requests are pushed as a stack, reverse it.
+        while (req) {
+            PollRequest *next = req->next;
+            req->next = prev;
+            prev = req;
+            req = next;
+        }
+        while (prev) {
+            req = prev;
+            prev = req->next;
+            runRequest(req);
+        }
+    }
+
+    /**
+     * @brief Apply a request, an error of a request not waited is
+     * reported to its callback with EV_ERR.
+    */
+    void runRequest(PollRequest *req) {
+        try {
+            switch (req->type) {
+            case PollRequest::R_ADD:
+                add(req->fd, req->handle, req->event, &req->cb, req->flags);
+                break;
+            case PollRequest::R_MOD:
+                mod(req->fd, req->handle, req->event, &req->cb);
+                break;
+            case PollRequest::R_DEL:
+                del(req->fd, req->handle, req->event);
+                break;
+            case PollRequest::R_REARM:
+                rearm(req->fd, req->handle);
+                break;
+            }
+        } catch (PollException &e) {
+            if (req->waited) {
+                req->error = std::current_exception();
+            } else if (req->cb) {
+                req->cb(Poll::EV_ERR, req->handle);
+            }
+        }
+        if (req->waited) {
+            req->notify();
+        } else {
+            delete req;
+        }
+    }
+
+    /**
+     * @brief Get the callback of the handle event.
+     * @details The running callback is not touched until it returns,
+     * the callback set to it is kept aside and moved in after it returns.
+     *
+     * @param replace is true to get the callback to replace.
+    */
+    Poll::Callback &getCallback(HandleState *state, int event,
+        bool replace = false) {
+        if (state == runState && event == runEvent &&
+            (replace || runReplaced)) {
+            runReplaced = true;
+            return runNext;
+        }
+        return state->cbs[event];
+    }
+
+    /**
+     * @brief Call the callback of the handle event.
+     * @note The state is looked up again for each event,
+     * because the previous callback may delete or reuse it.
+     * @param slot is the event whose callback is called, -1 means event
+    */
+    void callEvent(u64 data, Poll::Event event, int slot = -1) {
+        HandleState *state = findState(data);
+        if (slot < 0) {
+            slot = event;
+        }
+        if (!state || !state->cbs[slot]) {
+            return;
+        }
+        runState = state;
+        runEvent = slot;
+        try {
+            state->cbs[slot](event, state->handle);
+        } catch (...) {
+            endEvent();
+            throw;
+        }
+        endEvent();
+    }
+
+    /**
+     * @brief Report a failed change of the handle.
+     * @note Without an EV_ERR callback, the failure is reported to the
+     * callbacks of the other events with EV_ERR, so the one waiting for
+     * the change learns it, like a failed request in runRequest().
+    */
+    void reportFailure(u64 data) {
+        HandleState *state = findState(data);
+        if (!state) {
+            return;
+        }
+        if (state->cbs[Poll::EV_ERR]) {
+            callEvent(data, Poll::EV_ERR);
+            return;
+        }
+        for (int i = 0; i < Poll::EV_ERR; i++) {
+            callEvent(data, Poll::EV_ERR, i);
+        }
+    }
+
+    /**
+     * @brief Move in the callback set during the running callback.
+    */
+    void endEvent() {
+        if (runReplaced) {
+            runState->cbs[runEvent] = std::move(runNext);
+            runReplaced = false;
+        }
+        runState = nullptr;
+    }
+
+    void add(int fd, Handle *handle, Poll::Event event, Poll::Callback *cb,
+        int flags) {
+        HandleState *state = nullptr;
+        u32 epflags = getEpollFlags(flags);
+        u32 oldEvents;
+        bool fresh;
+        int epopt;
+
+        state = getState(fd);
+        if (!state) {
+            throw PollException(poll, common::ERR_OVER_RANGE,
+                "the handle is out of range");
+        }
+        if (state->handle != handle) {
+            // The state is unused or left by a closed handle with the same fd.
+            if (state->handle) {
+                releaseState(state);
+            }
+            state->events = 0;
+            for (int i = 0; i < POLL_EVENT_NUM; i++) {
+                getCallback(state, i, true).reset();
+            }
+        }
+        if (getCallback(state, event)) {
+            throw PollException(poll, common::ERR_EXIST,
+                "the poll callback of the handle is added");
+        }
+        if (state->handle && (state->events & POLL_EPOLL_FLAGS) != epflags) {
+            throw PollException(poll, common::ERR_INVAL_ARG,
+                "the flags are different from the added events");
+        }
+        fresh = !state->handle;
+        oldEvents = state->events;
+        if (fresh) {
+            state->handle = handle;
+            state->gen++;
+            state->prio = (flags & Poll::F_PRIO_HIGH) ? POLL_PRIO_HIGH :
+                (flags & Poll::F_PRIO_LOW) ? POLL_PRIO_LOW : POLL_PRIO_NORMAL;
+            state->ready = false;
+            if (state->prio != POLL_PRIO_NORMAL) {
+                prioNum++;
+            }
+            handleNum++;
+            if ((flags & Poll::F_BUSY_POLL) && busyPollUs) {
+                // Not a socket or not permitted, spin without it.
+                int us = static_cast<int>(busyPollUs);
+                setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us));
+            }
+        }
+        state->events = oldEvents | getEpollEvent(event) | epflags;
+        getCallback(state, event, true) = std::move(*cb);
+        // Apply the change at once if the handle is not in the backend,
+        // so the errors can be thrown. EPOLLEXCLUSIVE can't be modified later.
+        if (!state->kevents || (epflags & EPOLLEXCLUSIVE)) {
+            if (applyChange(fd, state, &epopt) < 0) {
+                state->events = oldEvents;
+                *cb = std::move(getCallback(state, event, true));
+                if (fresh) {
+                    releaseState(state);
+                }
+                epollCtlExcept(epopt, errno, poll);
+            }
+        } else {
+            queueChange(fd, state, fresh ? POLL_CHANGE_GEN : 0);
+        }
+    }
+
+    void mod(int fd, Handle *handle, Poll::Event event, Poll::Callback *cb) {
+        HandleState *state = findState(fd);
+        if (!state || state->handle != handle) {
+            throw PollException(poll, common::ERR_NOENT,
+                " the handle is not added");
+        }
+        if (!getCallback(state, event)) {
+            throw PollException(poll, common::ERR_NOENT,
+                "the poll callback of the handle is not added");
+        }
+        getCallback(state, event, true) = std::move(*cb);
+    }
+
+    void del(int fd, Handle *handle, Poll::Event event) {
+        HandleState *state = findState(fd);
+        int epopt;
+
+        if (!state || state->handle != handle) {
+            throw PollException(poll, common::ERR_NOENT,
+                " the handle is not added");
+        }
+        if (!getCallback(state, event)) {
+            throw PollException(poll, common::ERR_NOENT,
+                "the poll callback of the handle is not added");
+        }
+        state->events &= ~getEpollEvent(event);
+        getCallback(state, event, true).reset();
+        if (!(state->events & ~POLL_EPOLL_FLAGS)) {
+            releaseState(state);
+            state->events = 0;
+        }
+        if (state->kevents & EPOLLEXCLUSIVE) {
+            if (applyChange(fd, state, &epopt) < 0 &&
+                epopt != EPOLL_CTL_DEL) {
+                epollCtlExcept(epopt, errno, poll);
+            }
+        } else {
+            queueChange(fd, state);
+        }
+    }
+
+    void rearm(int fd, Handle *handle) {
+        HandleState *state = findState(fd);
+        if (!state || state->handle != handle) {
+            throw PollException(poll, common::ERR_NOENT,
+                " the handle is not added");
+        }
+        queueChange(fd, state, POLL_CHANGE_REARM);
+    }
+
+    /**
+     * @brief Release the state of a removed handle.
+    */
+    void releaseState(HandleState *state) {
+        if (state->prio != POLL_PRIO_NORMAL) {
+            prioNum--;
+        }
+        state->handle = nullptr;
+        handleNum--;
+    }
+
+    /**
+     * @brief Find the state of the added handle from the epoll data.
+     *
+     * @return the handle state, nullptr if the state is removed or reused.
+    */
+    HandleState *findState(u64 data) const {
+        HandleState *state = findState(static_cast<int>(data & 0xffffffff));
+        if (!state || !state->handle ||
+            state->gen != static_cast<u32>(data >> 32)) {
+            return nullptr;
+        }
+        return state;
+    }
+
+    /**
+     * @brief Call the EV_READ callback of the handle in the read budget.
+     * @details The callback is called again while it sets the handle ready,
+     * the handle is carried to the next iteration if the budget runs out.
+     *
+     * @param again is true if the handle is carried from the last iteration
+    */
+    void callRead(u64 data, bool again) {
+        HandleState *state = findState(data);
+        if (!state) {
+            return;
+        }
+        if (state->ready && !again) {
+            // It's carried, the kernel reports the readiness again.
+            return;
+        }
+        if (state->iter != iter) {
+            state->iter = iter;
+            state->reads = 0;
+        }
+        do {
+            if (state->reads >= readBudget) {
+                state->ready = true;
+                carried.push_back(data);
+                return;
+            }
+            state->ready = false;
+            state->reads++;
+            callEvent(data, Poll::EV_READ);
+            // The state may be removed or reused by the callback.
+            state = findState(data);
+        } while (state && state->ready);
+    }
+
+    /**
+     * @brief Dispatch an event from the backend.
+    */
+    void dispatch(const PollEvent &event) {
+        if (!event.events) {
+            callRead(event.data, true);
+            return;
+        }
+        // Hang up is reported as EV_READ, the read returns end of file.
+        if (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+            callRead(event.data, false);
+        }
+        if (event.events & EPOLLOUT) {
+            callEvent(event.data, Poll::EV_WRITE);
+        }
+        if (event.events & EPOLLERR) {
+            callEvent(event.data, Poll::EV_ERR);
+        }
+    }
+
+    /**
+     * @brief Dispatch the events from the backend and the carried handles.
+     * @details The events are queued by the priority classes if there are
+     * handles not in the normal class or carried handles.
+    */
+    void dispatchEvents(int num) {
+        bool queued = prioNum || !carried.empty();
+        QueueScope scope(this);
+        for (int i = 0; i < num; i++) {
+            struct epoll_event *epevt = events + i;
+            if (epevt->data.u64 == POLL_DATA_WAKEUP) {
+                eventfd_t value;
+                // Drain first, a wakeup() between the two finds woken set
+                // and returns, the poll is awake to handle it anyway.
+                // Clearing first would let the read eat its write,
+                // and leave woken set with the eventfd empty.
+                eventfd_read(evfd, &value);
+                woken.store(false, std::memory_order_release);
+                continue;
+            }
+            if (epevt->data.u64 == POLL_DATA_SIGNAL) {
+                readSignals();
+                continue;
+            }
+            PollEvent event(epevt->data.u64, epevt->events);
+            if (!queued) {
+                dispatch(event);
+                continue;
+            }
+            HandleState *state = findState(event.data);
+            if (state) {
+                queues[state->prio].push_back(event);
+            }
+        }
+        if (!queued) {
+            return;
+        }
+        for (size_t i = 0; i < carried.size(); i++) {
+            HandleState *state = findState(carried[i]);
+            if (state) {
+                queues[state->prio].push_back(PollEvent(carried[i], 0));
+            }
+        }
+        carried.clear();
+        for (u32 prio = 0; prio < POLL_PRIO_NUM; prio++) {
+            // A callback may add a handle, don't hold the reference.
+            for (size_t i = 0; i < queues[prio].size(); i++) {
+                dispatch(queues[prio][i]);
+            }
+            queues[prio].clear();
+        }
+    }
+
+    /**
+     * @brief Clear the queues when the dispatch ends, the events left by
+     * a callback throwing are dropped, not dispatched by the next polling().
+    */
+    class QueueScope {
+     public:
+        explicit QueueScope(PollPriv *priv): priv(priv) {}
+
+        ~QueueScope() {
+            for (u32 prio = 0; prio < POLL_PRIO_NUM; prio++) {
+                priv->queues[prio].clear();
+            }
+        }
+
+     private:
+        PollPriv *priv;
+    };
+
+    /**
+     * @brief Grow the event array if it's filled up by the backend.
+    */
+    void growEvents(int num) {
+        if (static_cast<u32>(num) < maxListen ||
+            maxListen >= PFM_EPOLL_MAX_LISTEN_LIMIT) {
+            return;
+        }
+        delete [] events;
+        maxListen *= 2;
+        events = new struct epoll_event[maxListen];
+    }
+
+    /**
+     * @brief Queue the change of the handle state to the changelist.
+     *
+     * @param change is the extra change, POLL_CHANGE_XXX
+    */
+    void queueChange(int fd, HandleState *state, u32 change = 0) {
+        if (state->change & POLL_CHANGE_QUEUED) {
+            ctlSaved++;
+        } else {
+            changes.push_back(fd);
+        }
+        state->change |= POLL_CHANGE_QUEUED | change;
+    }
+
+    /**
+     * @brief Apply the change of the handle state to the backend.
+     *
+     * @param op is the buffer to retrieve the operation of the backend
+     * @return 0 on success, -1 on error and errno is set.
+    */
+    int applyChange(int fd, HandleState *state, int *op) {
+        struct epoll_event epevt;
+        int ret;
+
+        state->change = 0;
+        if (!state->events) {
+            *op = EPOLL_CTL_DEL;
+            ret = backend->ctl(EPOLL_CTL_DEL, fd, nullptr);
+            ctlCalls++;
+            // The handle may be closed before, it's removed by the kernel.
+            state->kevents = 0;
+            return ret;
+        }
+        epevt.events = state->events;
+        epevt.data.u64 = packEpollData(fd, state->gen);
+        *op = state->kevents ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        ret = backend->ctl(*op, fd, &epevt);
+        ctlCalls++;
+        if (ret < 0 && *op == EPOLL_CTL_MOD && errno == ENOENT) {
+            // The fd was closed and reused after the last change.
+            *op = EPOLL_CTL_ADD;
+            ret = backend->ctl(*op, fd, &epevt);
+            ctlCalls++;
+        }
+        state->kevents = ret < 0 ? 0 : state->events;
+        return ret;
+    }
+
+    /**
+     * @brief Apply the changelist to the backend.
+     *
+     * @param failures is the buffer to retrieve the epoll data of
+     * the handles failed to change.
+    */
+    void applyChanges(std::vector<u64> *failures) {
+        for (size_t i = 0; i < changes.size(); i++) {
+            int fd = changes[i];
+            int op;
+            HandleState *state = findState(fd);
+            if (!(state->change & (POLL_CHANGE_REARM | POLL_CHANGE_GEN)) &&
+                state->events == state->kevents) {
+                state->change = 0;
+                ctlSaved++;
+                continue;
+            }
+            if (applyChange(fd, state, &op) < 0 && state->handle) {
+                failures->push_back(packEpollData(fd, state->gen));
+            }
+        }
+        changes.clear();
+    }
+
+    /**
+     * @brief Wait for the events of the backend.
+     * @details In the busy poll mode, it spins with non-blocking waits
+     * before blocking for the rest of the timeout.
+    */
+    int wait(int timeout) {
+        if (busyPollUs && timeout != 0) {
+            u64 budget = busyPollUs;
+            u64 start = getMonotonicUs();
+            u64 elapsed;
+            u64 spins = 0;
+            int ret;
+
+            if (timeout > 0 && budget > static_cast<u64>(timeout) * 1000) {
+                budget = static_cast<u64>(timeout) * 1000;
+            }
+            do {
+                ret = backend->wait(events, maxListen, 0);
+                spins++;
+                elapsed = getMonotonicUs() - start;
+            } while (ret == 0 && elapsed < budget);
+            spinWaits.store(spinWaits.load(std::memory_order_relaxed) + spins,
+                std::memory_order_relaxed);
+            if (ret != 0) {
+                if (ret > 0) {
+                    spinHits.store(spinHits.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+                }
+                return ret;
+            }
+            if (timeout > 0) {
+                timeout -= static_cast<int>(elapsed / 1000);
+                if (timeout <= 0) {
+                    return 0;
+                }
+            }
+        }
+        blockWaits.store(blockWaits.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        return backend->wait(events, maxListen, timeout);
+    }
+
+    /**
+     * @brief Read the signals from the signalfd and call their callbacks.
+    */
+    void readSignals() {
+        struct signalfd_siginfo infos[PFM_POLL_SIGNAL_BATCH];
+        ssize_t len;
+
+        do {
+            len = read(sigfd, infos, sizeof(infos));
+            for (ssize_t i = 0; i < len / static_cast<ssize_t>(
+                sizeof(infos[0])); i++) {
+                int signo = infos[i].ssi_signo;
+                // The callback may delete the signal.
+                PollSignal sig = signals[signo];
+                if (sig.cb) {
+                    sig.cb(signo, sig.arg);
+                }
+            }
+        } while (len == sizeof(infos));
+    }
+
+    /**
+     * @brief Run the posted tasks in posted order.
+    */
+    void runTasks() {
+        PollTask *task = tasks.exchange(nullptr, std::memory_order_acquire);
+        PollTask *prev = nullptr;
+        // The tasks are pushed as a stack, reverse it.
+        while (task) {
+            PollTask *next = task->next;
+            task->next = prev;
+            prev = task;
+            task = next;
+        }
+        while (prev) {
+            task = prev;
+            prev = task->next;
+            task->fn(task->arg);
+            delete task;
+        }
+    }
+
+    Poll *poll;
+    std::atomic<u64> owner;         ///< id of the owner thread, 0 if none
+    std::atomic<bool> isPolling;
+    PollBackend *backend;
+    Poll::Backend backendType;
+    int evfd;               ///< eventfd to wakeup the backend
+    int sigfd;              ///< signalfd of the added signals, -1 if none
+    sigset_t sigmask;       ///< the added signals
+    PollSignal *signals;    ///< callbacks indexed by the signal number
     u32 maxListen;
-    Lock mutex;
     struct epoll_event *events;
-    std::map<Handle *, HandleState *> stateMap;
+    HandleState **pages;    ///< pages of the state table, never moved
+    std::atomic<u32> handleNum;     ///< the number of added handles
+    u32 prioNum;            ///< the number of handles not in POLL_PRIO_NORMAL
+    u32 iter;               ///< the iteration of polling()
+    u32 readBudget;
+    std::vector<PollEvent> queues[POLL_PRIO_NUM];   ///< events to dispatch
+    std::vector<u64> carried;       ///< handles to call EV_READ again
+    std::vector<int> changes;       ///< fds of the changed handle states
+    std::atomic<u64> ctlCalls;
+    std::atomic<u64> ctlSaved;
+    u32 busyPollUs;                 ///< spin budget of the busy poll mode
+    std::atomic<u64> spinWaits;
+    std::atomic<u64> spinHits;
+    std::atomic<u64> blockWaits;
+    HandleState *runState;          ///< the state of the running callback
+    int runEvent;                   ///< the event of the running callback
+    bool runReplaced;               ///< the running callback is replaced
+    Poll::Callback runNext;         ///< the replacement of it
+    std::atomic<PollRequest *> requests;    ///< lock-free stack of requests
+    std::atomic<PollTask *> tasks;  ///< lock-free stack of posted tasks
+    std::atomic<bool> woken;        ///< the eventfd has been written
+    common::TimerWheel timers;
 };
 
-Poll::Poll(): priv(new PollPriv) {
-    priv->epfd = epoll_create(PFM_EPOLL_FD_MAX);
+Poll::Poll(Backend backend): priv(new PollPriv(this)) {
     priv->maxListen = PFM_EPOLL_MAX_LISTEN;
     priv->events = new struct epoll_event[priv->maxListen];
-    if (priv->epfd < 0) {
+    if (backend == B_URING) {
+        priv->backend = createUringBackend();
+        priv->backendType = B_URING;
+    }
+    if (!priv->backend) {
+        int epfd = epoll_create(PFM_EPOLL_FD_MAX);
+        if (epfd >= 0) {
+            priv->backend = new EpollBackend(epfd);
+            priv->backendType = B_DEFAULT;
+        }
+    }
+    if (!priv->backend) {
         switch (errno) {
         case EINVAL:
             throw PollException(this, common::ERR_INVAL_ARG,
@@ -120,148 +1030,307 @@ Poll::Poll(): priv(new PollPriv) {
             throw PollException(this, common::ERR_MEM);
             break;
         default:
+            throw PollException(this, common::ERR_ERR);
             break;
         }
     }
+    priv->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (priv->evfd < 0) {
+        throw PollException(this, common::ERR_ERR,
+            "eventfd(): failed to create the wakeup event");
+    }
+    struct epoll_event epevt;
+    epevt.events = EPOLLIN;
+    epevt.data.u64 = POLL_DATA_WAKEUP;
+    if (priv->backend->ctl(EPOLL_CTL_ADD, priv->evfd, &epevt) < 0) {
+        epollCtlExcept(EPOLL_CTL_ADD, errno, this);
+    }
 }
 
 Poll::~Poll() {
-    if (priv->epfd >= 0) {
-        close(priv->epfd);
+    if (priv->evfd >= 0) {
+        close(priv->evfd);
     }
-    delete priv->events;
+    delete [] priv->events;
     delete priv;
 }
 
-void Poll::add(Handle *handle, Event event, cb_t cb,  void *arg) {
-    HandleState *state = nullptr;
-    PollCallback *pollCb = nullptr;
-    struct epoll_event epevt;
-    int epopt;
-    int ret;
+/**
+ * @brief Mark the poll polling in a scope, it's unmarked even if
+ * a callback throws.
+*/
+class PollingScope {
+ public:
+    explicit PollingScope(PollPriv *priv): priv(priv) {
+        priv->isPolling = true;
+    }
 
+    ~PollingScope() {
+        priv->isPolling = false;
+    }
+
+ private:
+    PollPriv *priv;
+};
+
+/**
+ * @brief Own the poll in a scope.
+*/
+class PollOwnership {
+ public:
+    explicit PollOwnership(PollPriv *priv): priv(priv), acquired(false) {}
+
+    ~PollOwnership() {
+        if (acquired) {
+            priv->release();
+        }
+    }
+
+    /**
+     * @brief Try to own the poll.
+     *
+     * @return true if the calling thread owns the poll.
+    */
+    bool acquire() {
+        return priv->tryAcquire(&acquired);
+    }
+
+ private:
+    PollPriv *priv;
+    bool acquired;
+};
+
+void Poll::add(Handle *handle, Event event, cb_t cb,  void *arg, int flags) {
+    ASSERT(cb);
+    add(handle, event, Callback(cb, arg), flags);
+}
+
+void Poll::add(Handle *handle, Event event, Callback cb, int flags) {
     ASSERT(handle);
     ASSERT(cb);
-    priv->mutex.lock();
-    auto stateIt = priv->stateMap.find(handle);
-    if (stateIt != priv->stateMap.end()) {
-        epopt = EPOLL_CTL_MOD;
-        state = stateIt->second;
-        pollCb = state->findPollCallback(event);
-        if (pollCb) {
-            throw PollException(this, common::ERR_EXIST,
-                "the poll callback of the handle is added");
-            goto end;
-        }
-        for (auto i : state->cbMap) {
-            epevt.events |= getEpollEvent(i.first);
-        }
-    } else {
-        epopt = EPOLL_CTL_ADD;
-        state = new HandleState(event, handle, cb, arg);
+    if ((flags & F_EXCLUSIVE) && priv->backendType == B_URING) {
+        throw PollException(this, common::ERR_INVAL_ARG,
+            "F_EXCLUSIVE is not supported by the io_uring backend");
     }
-    epevt.events |= getEpollEvent(event);
-    epevt.data.ptr = static_cast<void *>(state);
-    ret = epoll_ctl(priv->epfd, epopt, handle->priv->fd, &epevt);
-    if (ret < 0) {
-        if (epopt == EPOLL_CTL_ADD) {
-            delete state;
-        }
-        epollCtlExcept(epopt, errno, this);
-        goto end;
+    bool waited = flags & F_WAIT;
+    flags &= ~F_WAIT;
+    PollOwnership ownership(priv);
+    if (ownership.acquire()) {
+        priv->add(handle->priv->fd, handle, event, &cb, flags);
+        return;
     }
-    if (epopt == EPOLL_CTL_MOD) {
-        state->cbMap.insert({event, new PollCallback(cb, arg)});
+    if (!waited) {
+        priv->submit(new PollRequest(PollRequest::R_ADD, handle->priv->fd,
+            handle, event, std::move(cb), flags, false));
+        return;
+    }
+    PollRequest req(PollRequest::R_ADD, handle->priv->fd, handle, event,
+        std::move(cb), flags, true);
+    priv->submit(&req);
+    req.wait();
+    if (req.error) {
+        std::rethrow_exception(req.error);
     }
-    priv->stateMap.insert({handle, state});
-end:
-    priv->mutex.unlock();
 }
 
 void Poll::mod(Handle *handle, Event event, cb_t cb, void *arg) {
-    HandleState *state = nullptr;
-    PollCallback *pollCb = nullptr;
+    ASSERT(cb);
+    mod(handle, event, Callback(cb, arg));
+}
 
+void Poll::mod(Handle *handle, Event event, Callback cb) {
     ASSERT(handle);
     ASSERT(cb);
-    priv->mutex.lock();
-    auto stateIt = priv->stateMap.find(handle);
-    if (stateIt != priv->stateMap.end()) {
-        state = stateIt->second;
-        pollCb = state->findPollCallback(event);
-        if (!pollCb) {
-            throw PollException(this, common::ERR_NOENT,
-                "the poll callback of the handle is not added");
-            goto end;
-        }
-        pollCb->cb = cb;
-        pollCb->arg = arg;
-    } else {
-        throw PollException(this, common::ERR_NOENT,
-            " the handle is not added");
+    PollOwnership ownership(priv);
+    if (ownership.acquire()) {
+        priv->mod(handle->priv->fd, handle, event, &cb);
+        return;
     }
-end:
-    priv->mutex.unlock();
+    priv->submit(new PollRequest(PollRequest::R_MOD, handle->priv->fd,
+        handle, event, std::move(cb), 0, false));
 }
 
 void Poll::del(Handle *handle, Event event) {
-    HandleState *state = nullptr;
-    PollCallback *pollCb = nullptr;
-    struct epoll_event epevt;
-    int epopt;
-    int ret;
+    ASSERT(handle);
+    PollOwnership ownership(priv);
+    if (ownership.acquire()) {
+        priv->del(handle->priv->fd, handle, event);
+        return;
+    }
+    // Wait for the owner, the callback may be running.
+    PollRequest req(PollRequest::R_DEL, handle->priv->fd, handle, event,
+        Callback(), 0, true);
+    priv->submit(&req);
+    req.wait();
+    if (req.error) {
+        std::rethrow_exception(req.error);
+    }
+}
 
+void Poll::rearm(Handle *handle) {
     ASSERT(handle);
-    priv->mutex.lock();
-    auto stateIt = priv->stateMap.find(handle);
-    if (stateIt != priv->stateMap.end()) {
-        state = stateIt->second;
-        pollCb = state->findPollCallback(event);
-        if (!pollCb) {
-            throw PollException(this, common::ERR_NOENT,
-                "the poll callback of the handle is not added");
-            goto end;
-        }
-        if (state->cbMap.size() == 1) {
-            epopt = EPOLL_CTL_DEL;
-        } else {
-            epopt = EPOLL_CTL_MOD;
-            for (auto i : state->cbMap) {
-                epevt.events |= getEpollEvent(i.first);
-            }
-            epevt.events &= ~getEpollEvent(event);
+    PollOwnership ownership(priv);
+    if (ownership.acquire()) {
+        priv->rearm(handle->priv->fd, handle);
+        return;
+    }
+    priv->submit(new PollRequest(PollRequest::R_REARM, handle->priv->fd,
+        handle, EV_READ, Callback(), 0, false));
+}
+
+void Poll::addSignal(int signo, signal_cb_t cb, void *arg) {
+    sigset_t mask;
+    int fd;
+
+    ASSERT(cb);
+    if (signo <= 0 || signo >= NSIG || signo == SIGKILL || signo == SIGSTOP) {
+        throw PollException(this, common::ERR_INVAL_ARG,
+            "the signal can't be handled");
+    }
+    PollOwnership ownership(priv);
+    if (!ownership.acquire()) {
+        throw PollException(this, common::ERR_BUSY,
+            "the poll is owned by another thread");
+    }
+    if (!priv->signals) {
+        priv->signals = new PollSignal[NSIG];
+    }
+    if (priv->signals[signo].cb) {
+        throw PollException(this, common::ERR_EXIST,
+            "the signal is added");
+    }
+    // Block the signal first, a signal arriving now is left pending.
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    mask = priv->sigmask;
+    sigaddset(&mask, signo);
+    fd = signalfd(priv->sigfd, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        throw PollException(this, errno == ENOMEM ? common::ERR_MEM :
+            common::ERR_ERR, "signalfd(): failed to watch the signal");
+    }
+    if (priv->sigfd < 0) {
+        struct epoll_event epevt;
+        epevt.events = EPOLLIN;
+        epevt.data.u64 = POLL_DATA_SIGNAL;
+        if (priv->backend->ctl(EPOLL_CTL_ADD, fd, &epevt) < 0) {
+            int err = errno;
+            close(fd);
+            epollCtlExcept(EPOLL_CTL_ADD, err, this);
+            throw PollException(this, common::ERR_ERR);
         }
-    } else {
+        priv->sigfd = fd;
+    }
+    priv->sigmask = mask;
+    priv->signals[signo].cb = cb;
+    priv->signals[signo].arg = arg;
+}
+
+void Poll::delSignal(int signo) {
+    PollOwnership ownership(priv);
+    if (!ownership.acquire()) {
+        throw PollException(this, common::ERR_BUSY,
+            "the poll is owned by another thread");
+    }
+    if (signo <= 0 || signo >= NSIG || !priv->signals ||
+        !priv->signals[signo].cb) {
         throw PollException(this, common::ERR_NOENT,
-            " the handle is not added");
+            "the signal is not added");
     }
-    epevt.data.ptr = static_cast<void *>(state);
-    ret = epoll_ctl(priv->epfd, epopt, handle->priv->fd,
-        epopt == EPOLL_CTL_MOD ? &epevt : nullptr);
-    if (ret < 0) {
-        epollCtlExcept(epopt, errno, this);
-        goto end;
+    sigdelset(&priv->sigmask, signo);
+    signalfd(priv->sigfd, &priv->sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    priv->signals[signo] = PollSignal();
+}
+
+Poll::Backend Poll::getBackend() const {
+    return priv->backendType;
+}
+
+u32 Poll::getSize() const {
+    return priv->handleNum.load(std::memory_order_relaxed);
+}
+
+void Poll::getStats(Stats *stats) const {
+    ASSERT(stats);
+    stats->ctlCalls = priv->ctlCalls.load(std::memory_order_relaxed);
+    stats->ctlSaved = priv->ctlSaved.load(std::memory_order_relaxed);
+    stats->spinWaits = priv->spinWaits.load(std::memory_order_relaxed);
+    stats->spinHits = priv->spinHits.load(std::memory_order_relaxed);
+    stats->blockWaits = priv->blockWaits.load(std::memory_order_relaxed);
+}
+
+void Poll::setBusyPoll(u32 us) {
+    priv->busyPollUs = us;
+}
+
+void Poll::setReadBudget(u32 num) {
+    ASSERT(num);
+    priv->readBudget = num;
+}
+
+void Poll::setReady(Handle *handle) {
+    ASSERT(handle);
+    PollOwnership ownership(priv);
+    if (!ownership.acquire()) {
+        throw PollException(this, common::ERR_BUSY,
+            "the poll is owned by another thread");
     }
-    if (epopt == EPOLL_CTL_MOD) {
-        state->cbMap.erase(event);
-    } else {
-        priv->stateMap.erase(handle);
+    int fd = handle->priv->fd;
+    HandleState *state = priv->findState(fd);
+    if (!state || state->handle != handle || !state->cbs[EV_READ]) {
+        throw PollException(this, common::ERR_NOENT,
+            "the poll callback of the handle is not added");
     }
-end:
-    priv->mutex.unlock();
+    if (state->ready) {
+        return;
+    }
+    state->ready = true;
+    // The running EV_READ callback is called again by callRead().
+    if (priv->runState != state || priv->runEvent != EV_READ) {
+        priv->carried.push_back(packEpollData(fd, state->gen));
+    }
+}
+
+void Poll::addTimer(common::Timer *timer, u32 ms,
+    common::Timer::cb_t cb, void *arg) {
+    priv->timers.add(timer, Clock::Instance().getTotalMs() + ms, cb, arg);
+}
+
+void Poll::delTimer(common::Timer *timer) {
+    priv->timers.del(timer);
 }
 
 void Poll::polling(int timeout) {
-    struct epoll_event *epevt;
-    HandleState *state;
-    PollCallback *pollCb;
+    std::vector<u64> failures;
+    int timerTimeout;
     if (priv->isPolling) {
         throw PollException(this, common::ERR_BUSY, "polling");
         return;
     }
-    priv->isPolling = true;
-    int ret = epoll_wait(priv->epfd, priv->events,
-        priv->maxListen, timeout);
+    PollOwnership ownership(priv);
+    // Another thread may own the poll for a registration.
+    while (!ownership.acquire()) {
+        if (priv->isPolling) {
+            throw PollException(this, common::ERR_BUSY, "polling");
+        }
+        sched_yield();
+    }
+    PollingScope polling(priv);
+    priv->runRequests();
+    priv->applyChanges(&failures);
+    for (size_t i = 0; i < failures.size(); i++) {
+        priv->reportFailure(failures[i]);
+    }
+    timerTimeout = priv->timers.getTimeout(Clock::Instance().getTotalMs());
+    if (timerTimeout >= 0 && (timeout < 0 || timerTimeout < timeout)) {
+        timeout = timerTimeout;
+    }
+    // The carried handles are still readable.
+    if (!priv->carried.empty()) {
+        timeout = 0;
+    }
+    int ret = priv->wait(timeout);
     if (ret < 0) {
         switch (errno) {
         case EINTR:
@@ -270,24 +1339,44 @@ void Poll::polling(int timeout) {
             throw PollException(this, common::ERR_ERR);
         }
     }
-    for (int i = 0; i < ret; i++) {
-        epevt = priv->events + i;
-        state = static_cast<HandleState *>(epevt->data.ptr);
-        if (epevt->events & EPOLLIN) {
-            callPollEvent(state, EV_READ);
-        }
-        if (epevt->events & EPOLLOUT) {
-            callPollEvent(state, EV_WRITE);
-        }
-        if (epevt->events & EPOLLERR) {
-            callPollEvent(state, EV_ERR);
-        }
+    // The requests are applied before the events of the removed handles.
+    priv->runRequests();
+    priv->iter++;
+    if (ret < 0) {
+        ret = 0;
     }
-    priv->isPolling = false;
+    priv->dispatchEvents(ret);
+    priv->growEvents(ret);
+    priv->runTasks();
+    priv->timers.run(Clock::Instance().getTotalMs());
 }
 
 void Poll::wakeup() {
-    {}
+    if (priv->woken.exchange(true)) {
+        return;
+    }
+    if (eventfd_write(priv->evfd, 1) < 0) {
+        priv->woken.store(false);
+        throw PollException(this, common::ERR_ERR,
+            "eventfd_write(): failed to wakeup the poll");
+    }
+}
+
+void Poll::post(task_t fn, void *arg) {
+    PollTask *task;
+    PollTask *head;
+
+    ASSERT(fn);
+    task = new PollTask(fn, arg);
+    head = priv->tasks.load(std::memory_order_relaxed);
+    do {
+        task->next = head;
+    } while (!priv->tasks.compare_exchange_weak(head, task,
+        std::memory_order_release, std::memory_order_relaxed));
+    // The tasks were empty, the polling() may be sleeping.
+    if (!head) {
+        wakeup();
+    }
 }
 
 static uint32_t getEpollEvent(Poll::Event event) {
@@ -303,6 +1392,23 @@ static uint32_t getEpollEvent(Poll::Event event) {
     }
 }
 
+static uint32_t getEpollFlags(int flags) {
+    uint32_t epflags = 0;
+    if (flags & Poll::F_EDGE) {
+        epflags |= EPOLLET;
+    }
+    if (flags & Poll::F_ONESHOT) {
+        epflags |= EPOLLONESHOT;
+    }
+    if (flags & Poll::F_RDHUP) {
+        epflags |= EPOLLRDHUP;
+    }
+    if (flags & Poll::F_EXCLUSIVE) {
+        epflags |= EPOLLEXCLUSIVE;
+    }
+    return epflags;
+}
+
 static void epollCtlExcept(int epopt, int err, Poll *poll) {
     const ErrorDesc *desc = nullptr;
     switch (epopt) {
@@ -328,11 +1434,4 @@ static void epollCtlExcept(int epopt, int err, Poll *poll) {
     }
 }
 
-static void callPollEvent(HandleState *state, Poll::Event event) {
-    PollCallback *pollCb = state->findPollCallback(event);
-    if (pollCb) {
-        pollCb->cb(event, state->handle, pollCb->arg);
-    }
-}
-
 }  // namespace platform
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <common/assert.hpp>
+#include <common/log.hpp>
+#include <platform/poll_group.hpp>
+
+namespace platform {
+
+class PollGroupPriv;
+
+/**
+ * @brief A poll and the thread doing its polling().
+*/
+class PollThread {
+ public:
+    PollThread(): group(nullptr), cpu(0) {}
+
+    PollGroupPriv *group;
+    Poll poll;
+    pthread_t tid;
+    u32 cpu;            ///< the CPU which the thread is pinned to
+};
+
+class PollGroupPriv {
+ public:
+    explicit PollGroupPriv(u32 num, PollGroup::Policy policy):
+        num(num), policy(policy), running(false), started(false), next(0) {
+        long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpuNum <= 0) {
+            cpuNum = 1;
+        }
+        if (!this->num) {
+            this->num = static_cast<u32>(cpuNum);
+        }
+        threads = new PollThread[this->num];
+        for (u32 i = 0; i < this->num; i++) {
+            threads[i].group = this;
+            threads[i].cpu = i % static_cast<u32>(cpuNum);
+        }
+    }
+
+    ~PollGroupPriv() {
+        delete [] threads;
+    }
+
+    u32 num;
+    PollGroup::Policy policy;
+    PollThread *threads;
+    std::atomic<bool> running;
+    bool started;
+    std::atomic<u32> next;      ///< the next poll of round-robin
+};
+
+static void *pollThreadEntry(void *arg) {
+    PollThread *thread = static_cast<PollThread *>(arg);
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(thread->cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) {
+        log_warn("failed to pin the poll thread to CPU %u", thread->cpu);
+    }
+    // An exception from a callback or the backend stops the thread,
+    // polling again would fail the same way.
+    try {
+        while (thread->group->running.load(std::memory_order_acquire)) {
+            thread->poll.polling(-1);
+        }
+    } catch (common::Exception &e) {
+        log_err("poll thread on CPU %u stopped: %s", thread->cpu, e.what());
+    }
+    return nullptr;
+}
+
+PollGroup::PollGroup(u32 num, Policy policy):
+    priv(new PollGroupPriv(num, policy)) {}
+
+PollGroup::~PollGroup() {
+    stop();
+    delete priv;
+}
+
+void PollGroup::start() {
+    if (priv->started) {
+        throw PollGroupException(this, common::ERR_BUSY,
+            "the poll group is started");
+    }
+    priv->running.store(true, std::memory_order_release);
+    for (u32 i = 0; i < priv->num; i++) {
+        if (pthread_create(&priv->threads[i].tid, nullptr,
+            pollThreadEntry, priv->threads + i)) {
+            priv->running.store(false, std::memory_order_release);
+            for (u32 j = 0; j < i; j++) {
+                priv->threads[j].poll.wakeup();
+                pthread_join(priv->threads[j].tid, nullptr);
+            }
+            throw PollGroupException(this, common::ERR_MEM,
+                "failed to create the poll thread");
+        }
+    }
+    priv->started = true;
+}
+
+void PollGroup::stop() {
+    if (!priv->started) {
+        return;
+    }
+    priv->running.store(false, std::memory_order_release);
+    for (u32 i = 0; i < priv->num; i++) {
+        priv->threads[i].poll.wakeup();
+    }
+    for (u32 i = 0; i < priv->num; i++) {
+        pthread_join(priv->threads[i].tid, nullptr);
+    }
+    priv->started = false;
+}
+
+u32 PollGroup::getSize() const {
+    return priv->num;
+}
+
+Poll *PollGroup::getPoll(u32 index) {
+    ASSERT(index < priv->num);
+    return &priv->threads[index].poll;
+}
+
+Poll *PollGroup::select(Handle *handle) {
+    u32 index = 0;
+
+    switch (priv->policy) {
+    case P_ROUND_ROBIN:
+        index = priv->next.fetch_add(1, std::memory_order_relaxed) %
+            priv->num;
+        break;
+    case P_LEAST_LOADED: {
+        u32 min = priv->threads[0].poll.getSize();
+        for (u32 i = 1; i < priv->num && min; i++) {
+            u32 size = priv->threads[i].poll.getSize();
+            if (size < min) {
+                min = size;
+                index = i;
+            }
+        }
+        break;
+    }
+    case P_HASH: {
+        // The handles are allocated on the heap, drop the aligned bits.
+        uintptr_t hash = reinterpret_cast<uintptr_t>(handle) >> 4;
+        hash ^= hash >> 16;
+        index = static_cast<u32>(hash % priv->num);
+        break;
+    }
+    default:
+        break;
+    }
+    return &priv->threads[index].poll;
+}
+
+Poll *PollGroup::add(Handle *handle, Poll::Event event,
+    Poll::cb_t cb, void *arg, int flags) {
+    Poll *poll = select(handle);
+    poll->add(handle, event, cb, arg, flags);
+    return poll;
+}
+
+void PollGroup::addShared(Handle *handle, Poll::Event event,
+    Poll::cb_t cb, void *arg) {
+    for (u32 i = 0; i < priv->num; i++) {
+        try {
+            priv->threads[i].poll.add(handle, event, cb, arg,
+                Poll::F_EXCLUSIVE | Poll::F_WAIT);
+        } catch (PollException &e) {
+            for (u32 j = 0; j < i; j++) {
+                priv->threads[j].poll.del(handle, event);
+            }
+            throw;
+        }
+    }
+}
+
+void PollGroup::delShared(Handle *handle, Poll::Event event) {
+    for (u32 i = 0; i < priv->num; i++) {
+        priv->threads[i].poll.del(handle, event);
+    }
+}
+
+}  // namespace platform
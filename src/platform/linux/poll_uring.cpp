@@ -0,0 +1,398 @@
+/**
+ * Copyright (c) 2020 KNpTrue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <platform/type.hpp>
+#include <platform/lock.hpp>
+#include <platform/poll_int.hpp>
+
+/// The number of entries of the submission queue.
+#define PFM_URING_SQ_ENTRIES 256
+/// The number of entries of the completion queue.
+#define PFM_URING_CQ_ENTRIES 4096
+
+/**
+ * The features required by the backend, IORING_FEAT_RSRC_TAGS is
+ * used to detect Linux 5.13 which supports the multishot poll.
+*/
+#define PFM_URING_FEATURES (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | \
+    IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS)
+
+namespace platform {
+
+/// The user data of the requests whose completions are ignored.
+static const u64 URING_DATA_IGNORE = ~static_cast<u64>(0);
+
+/// The epoll flags which are not poll events.
+static const u32 URING_EPOLL_FLAGS =
+    EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE | EPOLLWAKEUP;
+
+/**
+ * @brief The poll request of a file descriptor.
+*/
+class UringFile {
+ public:
+    UringFile(): events(0), seq(0), armed(false), data(0) {}
+
+    u32 events;     ///< epoll events and flags, 0 if it's unused
+    u32 seq;        ///< increased when the poll request is replaced
+    bool armed;     ///< the poll request is in the kernel
+    u64 data;       ///< epoll data
+};
+
+/**
+ * @brief The backend driven by io_uring.
+ * @details Each file descriptor has a poll request in the kernel.
+ * A level-triggered request is submitted again after it completes,
+ * an edge-triggered request is a multishot poll, a one-shot request,
+ * edge-triggered or not, is submitted again only by EPOLL_CTL_MOD. The requests are submitted
+ * in batch by the io_uring_enter() which waits for the completions.
+*/
+class UringBackend: public PollBackend {
+ public:
+    UringBackend(): ringFd(-1), ring(MAP_FAILED), ringSize(0),
+        sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)), sqesSize(0),
+        sqTail(0), waiting(false), mutex(Lock(Lock::LOCK_MUTEX)) {}
+
+    ~UringBackend() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (ring != MAP_FAILED) {
+            munmap(ring, ringSize);
+        }
+        if (ringFd >= 0) {
+            close(ringFd);
+        }
+    }
+
+    bool init() {
+        struct io_uring_params params;
+        u8 *ptr;
+
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = PFM_URING_CQ_ENTRIES;
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup,
+            PFM_URING_SQ_ENTRIES, &params));
+        if (ringFd < 0) {
+            return false;
+        }
+        if ((params.features & PFM_URING_FEATURES) != PFM_URING_FEATURES) {
+            return false;
+        }
+        ringSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+        size_t cqSize = params.cq_off.cqes +
+            params.cq_entries * sizeof(struct io_uring_cqe);
+        if (cqSize > ringSize) {
+            ringSize = cqSize;
+        }
+        ring = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr, sqesSize,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        ptr = static_cast<u8 *>(ring);
+        sqHeadPtr = reinterpret_cast<unsigned *>(ptr + params.sq_off.head);
+        sqTailPtr = reinterpret_cast<unsigned *>(ptr + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned *>(ptr + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqArray = reinterpret_cast<unsigned *>(ptr + params.sq_off.array);
+        cqHeadPtr = reinterpret_cast<unsigned *>(ptr + params.cq_off.head);
+        cqTailPtr = reinterpret_cast<unsigned *>(ptr + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned *>(ptr + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe *>(
+            ptr + params.cq_off.cqes);
+        sqTail = *sqTailPtr;
+        return true;
+    }
+
+    int ctl(int op, int fd, struct epoll_event *event) {
+        UringFile *file;
+        struct stat st;
+        int ret = 0;
+
+        if (fd < 0) {
+            errno = EBADF;
+            return -1;
+        }
+        mutex.lock();
+        if (static_cast<size_t>(fd) >= files.size()) {
+            if (op != EPOLL_CTL_ADD) {
+                mutex.unlock();
+                errno = ENOENT;
+                return -1;
+            }
+            size_t size = 2 * files.size();
+            if (size <= static_cast<size_t>(fd)) {
+                size = fd + 1;
+            }
+            files.resize(size);
+        }
+        file = &files[fd];
+        switch (op) {
+        case EPOLL_CTL_ADD:
+            if (file->events) {
+                errno = EEXIST;
+                ret = -1;
+                break;
+            }
+            // The poll requests can't wake up one of the rings only.
+            if (event->events & EPOLLEXCLUSIVE) {
+                errno = EINVAL;
+                ret = -1;
+                break;
+            }
+            // Follow epoll, regular files and directories can not be polled.
+            if (fstat(fd, &st) < 0) {
+                ret = -1;
+                break;
+            }
+            if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)) {
+                errno = EPERM;
+                ret = -1;
+                break;
+            }
+            file->seq++;
+            file->events = event->events;
+            file->data = event->data.u64;
+            ret = pollAdd(fd, file);
+            break;
+        case EPOLL_CTL_MOD:
+        case EPOLL_CTL_DEL:
+            if (!file->events) {
+                errno = ENOENT;
+                ret = -1;
+                break;
+            }
+            if (file->armed) {
+                pollRemove(fd, file);
+            }
+            file->seq++;
+            if (op == EPOLL_CTL_DEL) {
+                file->events = 0;
+                break;
+            }
+            file->events = event->events;
+            file->data = event->data.u64;
+            ret = pollAdd(fd, file);
+            break;
+        default:
+            errno = EINVAL;
+            ret = -1;
+            break;
+        }
+        // Submit now if the polling thread is sleeping in the kernel.
+        if (waiting.load()) {
+            submit();
+        }
+        mutex.unlock();
+        return ret;
+    }
+
+    int wait(struct epoll_event *events, int max, int timeout) {
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+        unsigned flags = IORING_ENTER_EXT_ARG;
+        unsigned minComplete = 0;
+        unsigned toSubmit;
+        int ret = 0;
+        int n = 0;
+
+        mutex.lock();
+        for (size_t i = 0; i < rearms.size(); i++) {
+            UringFile *file = &files[rearms[i]];
+            if (file->events && !file->armed) {
+                pollAdd(rearms[i], file);
+            }
+        }
+        rearms.clear();
+        toSubmit = publish();
+        if (timeout != 0 && __atomic_load_n(cqTailPtr, __ATOMIC_ACQUIRE) ==
+            *cqHeadPtr) {
+            flags |= IORING_ENTER_GETEVENTS;
+            minComplete = 1;
+        }
+        waiting.store(true);
+        mutex.unlock();
+
+        memset(&arg, 0, sizeof(arg));
+        if (timeout > 0) {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<u64>(&ts);
+        }
+        if (toSubmit || minComplete) {
+            ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd,
+                toSubmit, minComplete, flags, &arg, sizeof(arg)));
+        }
+        waiting.store(false);
+        if (ret < 0 && errno != ETIME && errno != EBUSY) {
+            return -1;
+        }
+
+        mutex.lock();
+        unsigned head = *cqHeadPtr;
+        unsigned tail = __atomic_load_n(cqTailPtr, __ATOMIC_ACQUIRE);
+        while (head != tail && n < max) {
+            struct io_uring_cqe *cqe = cqes + (head & cqMask);
+            head++;
+            if (cqe->user_data == URING_DATA_IGNORE) {
+                continue;
+            }
+            int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+            UringFile *file = &files[fd];
+            if (!file->events ||
+                file->seq != static_cast<u32>(cqe->user_data >> 32)) {
+                continue;
+            }
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                file->armed = false;
+                if (!(file->events & EPOLLONESHOT)) {
+                    rearms.push_back(fd);
+                }
+            }
+            events[n].events = cqe->res < 0 ?
+                EPOLLERR : static_cast<u32>(cqe->res);
+            events[n].data.u64 = file->data;
+            n++;
+        }
+        __atomic_store_n(cqHeadPtr, head, __ATOMIC_RELEASE);
+        mutex.unlock();
+        return n;
+    }
+
+ private:
+    /**
+     * @brief Get a free submission queue entry,
+     * submit the queued entries if the queue is full.
+    */
+    struct io_uring_sqe *getSqe() {
+        if (sqTail - __atomic_load_n(sqHeadPtr, __ATOMIC_ACQUIRE) >=
+            sqEntries) {
+            submit();
+            if (sqTail - __atomic_load_n(sqHeadPtr, __ATOMIC_ACQUIRE) >=
+                sqEntries) {
+                return nullptr;
+            }
+        }
+        unsigned index = sqTail & sqMask;
+        struct io_uring_sqe *sqe = sqes + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        sqTail++;
+        return sqe;
+    }
+
+    /**
+     * @brief Make the queued entries visible to the kernel.
+     *
+     * @return the number of entries to submit.
+    */
+    unsigned publish() {
+        __atomic_store_n(sqTailPtr, sqTail, __ATOMIC_RELEASE);
+        return sqTail - __atomic_load_n(sqHeadPtr, __ATOMIC_ACQUIRE);
+    }
+
+    void submit() {
+        unsigned toSubmit = publish();
+        if (toSubmit) {
+            syscall(__NR_io_uring_enter, ringFd, toSubmit, 0, 0, nullptr, 0);
+        }
+    }
+
+    int pollAdd(int fd, UringFile *file) {
+        struct io_uring_sqe *sqe = getSqe();
+        if (!sqe) {
+            errno = EBUSY;
+            return -1;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = file->events & ~URING_EPOLL_FLAGS;
+        // A one-shot request must not stay armed after it completes.
+        if ((file->events & EPOLLET) && !(file->events & EPOLLONESHOT)) {
+            sqe->len = IORING_POLL_ADD_MULTI;
+        }
+        sqe->user_data = (static_cast<u64>(file->seq) << 32) |
+            static_cast<u32>(fd);
+        file->armed = true;
+        return 0;
+    }
+
+    void pollRemove(int fd, UringFile *file) {
+        struct io_uring_sqe *sqe = getSqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = (static_cast<u64>(file->seq) << 32) |
+                static_cast<u32>(fd);
+            sqe->user_data = URING_DATA_IGNORE;
+        }
+        file->armed = false;
+    }
+
+    int ringFd;
+    void *ring;
+    size_t ringSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHeadPtr;
+    unsigned *sqTailPtr;
+    unsigned *sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqTail;        ///< the local tail of the submission queue
+    unsigned *cqHeadPtr;
+    unsigned *cqTailPtr;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+    std::atomic<bool> waiting;      ///< waiting in io_uring_enter()
+    Lock mutex;
+    std::vector<UringFile> files;   ///< indexed by the file descriptor
+    std::vector<int> rearms;        ///< files to submit the request again
+};
+
+PollBackend *createUringBackend() {
+    UringBackend *backend = new UringBackend;
+    if (!backend->init()) {
+        delete backend;
+        return nullptr;
+    }
+    return backend;
+}
+
+}  // namespace platform